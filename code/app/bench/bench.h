@@ -0,0 +1,110 @@
+/**
+ * @file bench.h
+ * @brief helpers of the host benchmarks
+ * @note host build only, see `make bench`
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdlib.h>
+#include <x86intrin.h>
+
+#include "bsp.h"
+#include "tinyos.h"
+#include "tos_config.h"
+#include "utils.h"
+
+
+#define BENCH_TASK_STACK_LEN (4 * 1024)
+
+#define bench_cycles()       __rdtsc()
+#define bench_report(...)    util_printk(__VA_ARGS__)
+
+
+typedef struct {
+    uint64_t total;
+    uint64_t max;
+    uint32_t count;
+} bench_stat_t;
+
+
+static inline void bench_stat_reset(bench_stat_t* stat)
+{
+    stat->total = 0;
+    stat->max   = 0;
+    stat->count = 0;
+}
+
+static inline void bench_stat_add(bench_stat_t* stat, uint64_t cycles)
+{
+    stat->total += cycles;
+    stat->count++;
+    if (cycles > stat->max) {
+        stat->max = cycles;
+    }
+}
+
+static inline uint32_t bench_stat_avg(const bench_stat_t* stat)
+{
+    return stat->count ? (uint32_t)(stat->total / stat->count) : 0;
+}
+
+static inline int bench_sample_compare(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief median of the samples, the avg of host is skewed by the tick and by the preemption of the host os
+ *
+ * @param stat
+ * @param samples one per bench_stat_add, sorted in place, so percentiles can be read from them after
+ * @return uint32_t
+ */
+static inline uint32_t bench_stat_median(const bench_stat_t* stat, uint32_t* samples)
+{
+    qsort(samples, stat->count, sizeof(uint32_t), bench_sample_compare);
+    return stat->count ? samples[stat->count / 2] : 0;
+}
+
+
+/**
+ * @brief create a task with a stack from the host heap
+ *
+ * @param proc
+ * @param args
+ * @param prio
+ * @param name
+ * @return tos_task_t
+ */
+static inline tos_task_t bench_task_create(tos_task_proc_t proc, void* args, uint8_t prio, char* name)
+{
+    tos_task_attr_t attr;
+
+    attr.task_stack_size = BENCH_TASK_STACK_LEN * sizeof(tos_stack_t);
+    attr.task_stack      = malloc(attr.task_stack_size);
+    attr.task_prio       = prio;
+    attr.task_wait_time  = 0;
+    attr.task_time_slice = 0;
+    attr.task_name       = name;
+
+    return tos_task_create(proc, args, &attr);
+}
+
+
+/**
+ * @brief init console and tos, create the bench task, and start tos
+ *
+ * @param proc
+ */
+static inline void bench_start(tos_task_proc_t proc)
+{
+    uart_console_init(0);
+    tos_init();
+    bench_task_create(proc, nullptr, TOS_MAX_PRIO_NUM_USED, "bench");
+    tos_start();
+}
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * @file bench_heap.c
+ * @brief cost of util_malloc/util_free under fragmentation, for the heap backend built
+ * @note a fixed random sequence of malloc/free of small and large blocks over a set of slots, every call is timed
+ *       in a critical section. max is mostly the preemption of the host os, see p99.9
+ *       to compare backends: CFLAGS=-DUTIL_HEAP_BACKEND=0 make BUILD=build_slot build_slot/bench_heap
+ */
+
+#include "bench.h"
+#include "util_heap.h"
+
+
+#define BENCH_HEAP_SLOTS     256
+#define BENCH_HEAP_OPS       200000
+#define BENCH_HEAP_SMALL_MAX 128   // 7 of 8 blocks
+#define BENCH_HEAP_LARGE_MAX 512
+
+
+static const char* bench_heap_backend = (UTIL_HEAP_BACKEND == UTIL_HEAP_BACKEND_TLSF) ? "tlsf" : "slot";
+
+static void*    bench_ptrs[BENCH_HEAP_SLOTS];
+static uint32_t bench_seed = 1;
+static uint32_t bench_malloc_samples[BENCH_HEAP_OPS];
+static uint32_t bench_free_samples[BENCH_HEAP_OPS];
+
+
+static uint32_t bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return bench_seed >> 8;
+}
+
+
+static void bench_print(const char* op, uint32_t* samples, bench_stat_t* stat)
+{
+    uint32_t median = bench_stat_median(stat, samples);
+
+    bench_report("%12s %8s %8u %8u %8u %8u %8u\n", op, bench_heap_backend, stat->count, median,
+                 samples[stat->count * 99 / 100], samples[stat->count * 999 / 1000], (uint32_t)stat->max);
+}
+
+
+static void bench_task(void* arg)
+{
+    bench_stat_t malloc_stat, free_stat;
+    uint32_t     fails = 0;
+    util_size_t  warm_size = util_heap_freesize() - 64;
+    void*        warm      = util_malloc(warm_size);
+    tos_use_critical_section();
+
+    // touch the whole heap first, page faults of the host are not the cost of heap
+    if (warm != nullptr) {
+        memset(warm, 0, warm_size);
+        util_free(warm);
+    }
+
+    bench_stat_reset(&malloc_stat);
+    bench_stat_reset(&free_stat);
+    for (int op = 0; op < BENCH_HEAP_OPS; op++) {
+        uint32_t slot = bench_rand() % BENCH_HEAP_SLOTS;
+        uint64_t start, cycles;
+
+        if (bench_ptrs[slot] == nullptr) {
+            uint32_t size = 1 + bench_rand() % ((bench_rand() % 8 == 0) ? BENCH_HEAP_LARGE_MAX : BENCH_HEAP_SMALL_MAX);
+
+            tos_enter_critical_section();
+            start            = bench_cycles();
+            bench_ptrs[slot] = util_malloc(size);
+            cycles           = bench_cycles() - start;
+            tos_leave_critical_section();
+
+            bench_malloc_samples[malloc_stat.count] = (uint32_t)cycles;
+            bench_stat_add(&malloc_stat, cycles);
+            fails += (bench_ptrs[slot] == nullptr);
+        } else {
+            tos_enter_critical_section();
+            start = bench_cycles();
+            util_free(bench_ptrs[slot]);
+            cycles = bench_cycles() - start;
+            tos_leave_critical_section();
+
+            bench_free_samples[free_stat.count] = (uint32_t)cycles;
+            bench_stat_add(&free_stat, cycles);
+            bench_ptrs[slot] = nullptr;
+        }
+    }
+
+    bench_report("\n%12s %8s %8s %8s %8s %8s %8s\n", "op", "backend", "count", "median", "p99", "p99.9", "max");
+    bench_print("util_malloc", bench_malloc_samples, &malloc_stat);
+    bench_print("util_free", bench_free_samples, &free_stat);
+    bench_report("malloc fails %u of %u\n", fails, malloc_stat.count);
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file bench_mempool.c
+ * @brief cost of getting and putting back a fixed-size block: util_malloc/util_free in a critical section, as
+ *        tos_malloc did, vs tos_mempool_alloc/tos_mempool_free
+ *
+ */
+
+#include "bench.h"
+#include "tos_mempool.h"
+#include "tos_static.h"
+#include "util_heap.h"
+
+
+#define BENCH_POOL_BLK_SIZE 64
+#define BENCH_POOL_NUM      64    // ops timed together, hide the cost of reading the cycle counter
+#define BENCH_POOL_LOOPS    10000
+
+
+static uint64_t              bench_pool_buffer[BENCH_POOL_BLK_SIZE * BENCH_POOL_NUM / sizeof(uint64_t)];
+static tos_mempool_storage_t bench_pool_storage;
+static tos_mempool_t         bench_pool;
+static void*                 bench_blks[BENCH_POOL_NUM];
+
+
+static void bench_task(void* arg)
+{
+    tos_mempool_attr_t attr = {bench_pool_buffer, BENCH_POOL_BLK_SIZE, BENCH_POOL_NUM};
+    bench_stat_t       heap_alloc_stat, heap_free_stat, pool_alloc_stat, pool_free_stat;
+    tos_use_critical_section();
+
+    tos_mempool_init_static(&bench_pool, &attr, &bench_pool_storage);
+
+    bench_stat_reset(&heap_alloc_stat);
+    bench_stat_reset(&heap_free_stat);
+    bench_stat_reset(&pool_alloc_stat);
+    bench_stat_reset(&pool_free_stat);
+    for (int loop = 0; loop < BENCH_POOL_LOOPS; loop++) {
+        uint64_t start = bench_cycles();
+        for (int i = 0; i < BENCH_POOL_NUM; i++) {
+            tos_enter_critical_section();
+            bench_blks[i] = util_malloc(BENCH_POOL_BLK_SIZE);
+            tos_leave_critical_section();
+        }
+        uint64_t end = bench_cycles();
+        bench_stat_add(&heap_alloc_stat, (end - start) / BENCH_POOL_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_POOL_NUM; i++) {
+            tos_enter_critical_section();
+            util_free(bench_blks[i]);
+            tos_leave_critical_section();
+        }
+        end = bench_cycles();
+        bench_stat_add(&heap_free_stat, (end - start) / BENCH_POOL_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_POOL_NUM; i++) {
+            bench_blks[i] = tos_mempool_alloc(&bench_pool);
+        }
+        end = bench_cycles();
+        bench_stat_add(&pool_alloc_stat, (end - start) / BENCH_POOL_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_POOL_NUM; i++) {
+            tos_mempool_free(&bench_pool, bench_blks[i]);
+        }
+        end = bench_cycles();
+        bench_stat_add(&pool_free_stat, (end - start) / BENCH_POOL_NUM);
+    }
+
+    bench_report("\n%20s %12s %12s\n", "op", "avg cycles", "max cycles");
+    bench_report("%20s %12u %12u\n", "heap malloc", bench_stat_avg(&heap_alloc_stat), (uint32_t)heap_alloc_stat.max);
+    bench_report("%20s %12u %12u\n", "heap free", bench_stat_avg(&heap_free_stat), (uint32_t)heap_free_stat.max);
+    bench_report("%20s %12u %12u\n", "tos_mempool_alloc", bench_stat_avg(&pool_alloc_stat), (uint32_t)pool_alloc_stat.max);
+    bench_report("%20s %12u %12u\n", "tos_mempool_free", bench_stat_avg(&pool_free_stat), (uint32_t)pool_free_stat.max);
+
+    tos_mempool_destroy(&bench_pool);
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file bench_msgq.c
+ * @brief throughput of a producer/consumer pair: shared data under mutex/cond vs msgq
+ *
+ */
+
+#include "bench.h"
+#include "tos_cond.h"
+#include "tos_msgq.h"
+#include "tos_mutex.h"
+
+#include <string.h>
+
+
+#define BENCH_MSG_SIZE  32
+#define BENCH_MSG_NUM   16
+#define BENCH_MSG_COUNT 100000
+#define BENCH_PRIO      2   // producer and consumer, lower than the bench task
+
+
+typedef struct {
+    uint32_t seq;
+    uint8_t  payload[BENCH_MSG_SIZE - sizeof(uint32_t)];
+} bench_msg_t;
+
+typedef enum {
+    BENCH_MODE_COND = 0,   // one message guarded by mutex/cond, like usr tasks of main_os.c
+    BENCH_MODE_COPY,       // tos_msgq_send/recv
+    BENCH_MODE_INPLACE,    // tos_msgq_reserve/commit and acquire/release
+    BENCH_MODE_NUM,
+} bench_mode_t;
+
+
+static const char* bench_mode_names[BENCH_MODE_NUM] = {"mutex+cond", "msgq copy", "msgq in place"};
+
+static tos_mutex_t bench_mutex;
+static tos_cond_t  bench_cond;
+static bench_msg_t bench_shared;
+static bool        bench_shared_full;
+
+static tos_msgq_t  bench_msgq;
+static bench_msg_t bench_msgq_buffer[BENCH_MSG_NUM];
+
+static bench_mode_t      bench_mode;
+static volatile bool     bench_done;
+static volatile uint32_t bench_errors;
+
+
+static void bench_producer(void* arg)
+{
+    bench_msg_t msg;
+
+    memset(&msg, 0xA5, sizeof(msg));
+    for (uint32_t seq = 1; seq <= BENCH_MSG_COUNT; seq++) {
+        msg.seq = seq;
+        switch (bench_mode) {
+        case BENCH_MODE_COND:
+            tos_mutex_lock(&bench_mutex);
+            while (bench_shared_full) {
+                tos_cond_wait(&bench_cond, &bench_mutex);
+            }
+            bench_shared      = msg;
+            bench_shared_full = true;
+            tos_cond_broadcast(&bench_cond);
+            tos_mutex_unlock(&bench_mutex);
+            break;
+
+        case BENCH_MODE_COPY:
+            tos_msgq_send(&bench_msgq, &msg, TOS_MSGQ_WAIT_INFINITE);
+            break;
+
+        case BENCH_MODE_INPLACE: {
+            bench_msg_t* slot;
+            tos_msgq_reserve(&bench_msgq, (void**)&slot, TOS_MSGQ_WAIT_INFINITE);
+            slot->seq = seq;
+            memset(slot->payload, 0xA5, sizeof(slot->payload));
+            tos_msgq_commit(&bench_msgq);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+
+static void bench_consumer(void* arg)
+{
+    bench_msg_t msg;
+
+    for (uint32_t seq = 1; seq <= BENCH_MSG_COUNT; seq++) {
+        switch (bench_mode) {
+        case BENCH_MODE_COND:
+            tos_mutex_lock(&bench_mutex);
+            while (!bench_shared_full) {
+                tos_cond_wait(&bench_cond, &bench_mutex);
+            }
+            msg               = bench_shared;
+            bench_shared_full = false;
+            tos_cond_broadcast(&bench_cond);
+            tos_mutex_unlock(&bench_mutex);
+            break;
+
+        case BENCH_MODE_COPY:
+            tos_msgq_recv(&bench_msgq, &msg, TOS_MSGQ_WAIT_INFINITE);
+            break;
+
+        case BENCH_MODE_INPLACE: {
+            bench_msg_t* slot;
+            tos_msgq_acquire(&bench_msgq, (void**)&slot, TOS_MSGQ_WAIT_INFINITE);
+            msg.seq = slot->seq;
+            tos_msgq_release(&bench_msgq);
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        if (msg.seq != seq) {
+            bench_errors++;
+        }
+    }
+    bench_done = true;
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_msgq_attr_t attr = {bench_msgq_buffer, sizeof(bench_msg_t), BENCH_MSG_NUM};
+
+    tos_mutex_init(&bench_mutex, nullptr);
+    tos_cond_init(&bench_cond, nullptr);
+    tos_msgq_init(&bench_msgq, &attr);
+
+    bench_report("\n%d messages of %d bytes, msgq of %d messages\n", BENCH_MSG_COUNT, BENCH_MSG_SIZE, BENCH_MSG_NUM);
+    bench_report("%15s %12s %8s\n", "mode", "cycles/msg", "errors");
+
+    for (bench_mode = 0; bench_mode < BENCH_MODE_NUM; bench_mode++) {
+        bench_done        = false;
+        bench_errors      = 0;
+        bench_shared_full = false;
+
+        uint64_t start = bench_cycles();
+        bench_task_create(bench_consumer, nullptr, BENCH_PRIO, "consumer");
+        bench_task_create(bench_producer, nullptr, BENCH_PRIO, "producer");
+        while (!bench_done) {
+            tos_task_sleep(1);
+        }
+        uint64_t end = bench_cycles();
+
+        bench_report("%15s %12u %8u\n", bench_mode_names[bench_mode], (uint32_t)((end - start) / BENCH_MSG_COUNT),
+                     bench_errors);
+        tos_task_sleep(10);   // producer and consumer exit
+    }
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file bench_mutex.c
+ * @brief cost of uncontended mutex lock/unlock
+ *
+ */
+
+#include "bench.h"
+#include "tos_mutex.h"
+
+
+#define BENCH_MUTEX_NUM   100   // ops timed together, hide the cost of reading the cycle counter
+#define BENCH_MUTEX_LOOPS 10000
+
+
+static tos_mutex_t bench_mutexes[BENCH_MUTEX_NUM];
+
+
+static void bench_task(void* arg)
+{
+    bench_stat_t lock_stat, unlock_stat;
+
+    for (int i = 0; i < BENCH_MUTEX_NUM; i++) {
+        tos_mutex_init(&bench_mutexes[i], nullptr);
+    }
+
+    bench_stat_reset(&lock_stat);
+    bench_stat_reset(&unlock_stat);
+    for (int loop = 0; loop < BENCH_MUTEX_LOOPS; loop++) {
+        uint64_t start = bench_cycles();
+        for (int i = 0; i < BENCH_MUTEX_NUM; i++) {
+            tos_mutex_lock(&bench_mutexes[i]);
+        }
+        uint64_t end = bench_cycles();
+        bench_stat_add(&lock_stat, (end - start) / BENCH_MUTEX_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_MUTEX_NUM; i++) {
+            tos_mutex_unlock(&bench_mutexes[i]);
+        }
+        end = bench_cycles();
+        bench_stat_add(&unlock_stat, (end - start) / BENCH_MUTEX_NUM);
+    }
+
+    bench_report("\n%10s %12s\n", "op", "avg cycles");
+    bench_report("%10s %12d\n", "lock", bench_stat_avg(&lock_stat));
+    bench_report("%10s %12d\n", "unlock", bench_stat_avg(&unlock_stat));
+
+    for (int i = 0; i < BENCH_MUTEX_NUM; i++) {
+        tos_mutex_destroy(&bench_mutexes[i]);
+    }
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
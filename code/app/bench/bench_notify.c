@@ -0,0 +1,187 @@
+/**
+ * @file bench_notify.c
+ * @brief wakeup of one known task: tos_cond_signal vs tos_sem_give vs tos_task_notify
+ * @note cycles from the signal call to the waiter running, the waiter has a higher prio than the signaller.
+ *       median is reported too, the avg of host is skewed by the tick and by the preemption of the host os.
+ *       then checks a notify arriving after the wait timed out but before the waiter runs, exits 1 if it's wrong
+ */
+
+#include "bench.h"
+#include "tos_cond.h"
+#include "tos_core_.h"
+#include "tos_mutex.h"
+#include "tos_notify.h"
+#include "tos_sem.h"
+#include "tos_static.h"
+
+
+#define BENCH_WAKEUP_LOOPS 20000
+#define BENCH_WAITER_PRIO  3
+#define BENCH_SIGNAL_PRIO  2
+#define BENCH_LATE_WAIT_MS 5    // the wait times out in it
+#define BENCH_LATE_SPIN_MS 30   // the waiter is kept from running in it
+
+
+typedef enum {
+    BENCH_MODE_COND = 0,
+    BENCH_MODE_SEM,
+    BENCH_MODE_NOTIFY,
+    BENCH_MODE_NUM,
+} bench_mode_t;
+
+
+static const char* bench_mode_names[BENCH_MODE_NUM] = {"cond_signal", "sem_give", "task_notify"};
+static const int   bench_mode_sizes[BENCH_MODE_NUM] = {
+    sizeof(tos_mutex_storage_t) + sizeof(tos_cond_storage_t), sizeof(tos_sem_storage_t), 0};
+
+static tos_mutex_t bench_mutex;
+static tos_cond_t  bench_cond;
+static tos_sem_t   bench_sem;
+static tos_task_t  bench_waiter_task;
+static bool        bench_flag;
+
+static bench_mode_t      bench_mode;
+static volatile uint64_t bench_start_cycles;
+static volatile bool     bench_done;
+static bench_stat_t      bench_stat;
+static uint32_t          bench_samples[BENCH_WAKEUP_LOOPS];
+static int               bench_late_ret;
+
+
+static void bench_sample(uint64_t cycles)
+{
+    bench_samples[bench_stat.count] = (uint32_t)cycles;
+    bench_stat_add(&bench_stat, cycles);
+}
+
+
+static void bench_waiter(void* arg)
+{
+    for (int loop = 0; loop < BENCH_WAKEUP_LOOPS; loop++) {
+        switch (bench_mode) {
+        case BENCH_MODE_COND:
+            tos_mutex_lock(&bench_mutex);
+            while (!bench_flag) {
+                tos_cond_wait(&bench_cond, &bench_mutex);
+            }
+            bench_flag = false;
+            bench_sample(bench_cycles() - bench_start_cycles);
+            tos_mutex_unlock(&bench_mutex);
+            break;
+
+        case BENCH_MODE_SEM:
+            tos_sem_take(&bench_sem);
+            bench_sample(bench_cycles() - bench_start_cycles);
+            break;
+
+        case BENCH_MODE_NOTIFY:
+            tos_task_notify_wait(0xFFFFFFFFu, nullptr, TOS_NOTIFY_WAIT_INFINITE);
+            bench_sample(bench_cycles() - bench_start_cycles);
+            break;
+
+        default:
+            break;
+        }
+    }
+    bench_done = true;
+}
+
+
+static void bench_late_waiter(void* arg)
+{
+    bench_late_ret = tos_task_notify_wait(0xFFFFFFFFu, nullptr, BENCH_LATE_WAIT_MS);
+    bench_done     = true;
+}
+
+
+/**
+ * @brief the timeout makes the waiter ready, a notify before it runs must not insert it into ready list again
+ *
+ * @return true the wait returns timeout, the notify is kept for the next wait
+ */
+static bool bench_late_notify_check(void)
+{
+    volatile uint32_t* ticks = &tos_state.sys_ticks;
+    uint32_t           end   = *ticks + BENCH_LATE_SPIN_MS / TOS_TICK_MS;
+
+    bench_done        = false;
+    bench_waiter_task = bench_task_create(bench_late_waiter, nullptr, BENCH_WAITER_PRIO, "late");
+    tos_task_sleep(1);   // the waiter blocks
+
+    // the bench task has the highest prio, the waiter times out but does not run
+    while ((int32_t)(*ticks - end) < 0) {
+    }
+    tos_task_notify(&bench_waiter_task, 1, TOS_NOTIFY_SET_BITS);
+
+    tos_task_sleep(BENCH_LATE_SPIN_MS);
+    return bench_done && bench_late_ret == TOS_ERR_NOTIFY_TIMEOUT;
+}
+
+
+static void bench_signaller(void* arg)
+{
+    while (!bench_done) {
+        switch (bench_mode) {
+        case BENCH_MODE_COND:
+            tos_mutex_lock(&bench_mutex);
+            bench_flag         = true;
+            bench_start_cycles = bench_cycles();
+            tos_cond_signal(&bench_cond);
+            tos_mutex_unlock(&bench_mutex);
+            break;
+
+        case BENCH_MODE_SEM:
+            bench_start_cycles = bench_cycles();
+            tos_sem_give(&bench_sem);
+            break;
+
+        case BENCH_MODE_NOTIFY:
+            bench_start_cycles = bench_cycles();
+            tos_task_notify(&bench_waiter_task, 0, TOS_NOTIFY_INCREMENT);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_mutex_init(&bench_mutex, nullptr);
+    tos_cond_init(&bench_cond, nullptr);
+    tos_sem_init(&bench_sem, 0, nullptr);
+
+    bench_report("\n%12s %12s %12s %12s %16s\n", "op", "median", "avg cycles", "max cycles", "object bytes");
+    for (bench_mode = 0; bench_mode < BENCH_MODE_NUM; bench_mode++) {
+        bench_done = false;
+        bench_flag = false;
+        bench_stat_reset(&bench_stat);
+
+        bench_waiter_task = bench_task_create(bench_waiter, nullptr, BENCH_WAITER_PRIO, "waiter");
+        bench_task_create(bench_signaller, nullptr, BENCH_SIGNAL_PRIO, "signaller");
+        while (!bench_done) {
+            tos_task_sleep(1);
+        }
+        tos_task_sleep(10);   // waiter and signaller exit
+
+        bench_report("%12s %12u %12u %12u %16d\n", bench_mode_names[bench_mode],
+                     bench_stat_median(&bench_stat, bench_samples), bench_stat_avg(&bench_stat),
+                     (uint32_t)bench_stat.max, bench_mode_sizes[bench_mode]);
+    }
+
+    if (!bench_late_notify_check()) {
+        bench_report("notify after timeout: wrong, ret %d\n", bench_late_ret);
+        exit(1);
+    }
+    bench_report("notify after timeout: ok\n");
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file bench_taskcache.c
+ * @brief cost of tos_malloc/tos_free of a size larger than the kernel pools: from the heap in a critical section, vs
+ *        from the cache of the task
+ *
+ */
+
+#include "bench.h"
+#include "tos_mem.h"
+#include "util_heap.h"
+
+
+#define BENCH_CACHE_BLK_SIZE 448   // above the largest kernel pool, not above TOS_TASK_CACHE_SIZE_MAX
+#define BENCH_CACHE_NUM      2     // blocks in flight, all fit in TOS_TASK_CACHE_BYTES_MAX
+#define BENCH_CACHE_LOOPS    100000
+
+
+static void* bench_blks[BENCH_CACHE_NUM];
+
+
+static void bench_task(void* arg)
+{
+    static tos_task_stat_t stats[16];
+    bench_stat_t           heap_alloc_stat, heap_free_stat, cache_alloc_stat, cache_free_stat;
+    uint32_t               num;
+
+    bench_stat_reset(&heap_alloc_stat);
+    bench_stat_reset(&heap_free_stat);
+    bench_stat_reset(&cache_alloc_stat);
+    bench_stat_reset(&cache_free_stat);
+    for (int loop = 0; loop < BENCH_CACHE_LOOPS; loop++) {
+        uint64_t start = bench_cycles();
+        for (int i = 0; i < BENCH_CACHE_NUM; i++) {
+            bench_blks[i] = tos_heap_malloc(BENCH_CACHE_BLK_SIZE);
+        }
+        uint64_t end = bench_cycles();
+        bench_stat_add(&heap_alloc_stat, (end - start) / BENCH_CACHE_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_CACHE_NUM; i++) {
+            tos_heap_free(bench_blks[i]);
+        }
+        end = bench_cycles();
+        bench_stat_add(&heap_free_stat, (end - start) / BENCH_CACHE_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_CACHE_NUM; i++) {
+            bench_blks[i] = tos_malloc(BENCH_CACHE_BLK_SIZE);
+        }
+        end = bench_cycles();
+        bench_stat_add(&cache_alloc_stat, (end - start) / BENCH_CACHE_NUM);
+
+        start = bench_cycles();
+        for (int i = 0; i < BENCH_CACHE_NUM; i++) {
+            tos_free(bench_blks[i]);
+        }
+        end = bench_cycles();
+        bench_stat_add(&cache_free_stat, (end - start) / BENCH_CACHE_NUM);
+    }
+
+    bench_report("\n%20s %12s %12s\n", "op", "avg cycles", "max cycles");
+    bench_report("%20s %12u %12u\n", "heap malloc", bench_stat_avg(&heap_alloc_stat), (uint32_t)heap_alloc_stat.max);
+    bench_report("%20s %12u %12u\n", "heap free", bench_stat_avg(&heap_free_stat), (uint32_t)heap_free_stat.max);
+    bench_report("%20s %12u %12u\n", "cached tos_malloc", bench_stat_avg(&cache_alloc_stat),
+                 (uint32_t)cache_alloc_stat.max);
+    bench_report("%20s %12u %12u\n", "cached tos_free", bench_stat_avg(&cache_free_stat), (uint32_t)cache_free_stat.max);
+
+    num = tos_get_task_stats(stats, util_arraylen(stats), nullptr);
+    for (uint32_t i = 0; i < num; i++) {
+        if (stats[i].task == tos_get_current_task()) {
+            bench_report("cache hit %u, miss %u, %u bytes held\n", stats[i].task_cache_hit, stats[i].task_cache_miss,
+                         stats[i].task_cache_bytes);
+        }
+    }
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
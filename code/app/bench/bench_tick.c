@@ -0,0 +1,62 @@
+/**
+ * @file bench_tick.c
+ * @brief cost of the tick ISR vs number of sleeping tasks
+ *
+ */
+
+#include "bench.h"
+#include "tos_core_.h"
+
+
+#define BENCH_TICK_LOOPS 10000
+
+static const uint32_t bench_sleeper_nums[] = {0, 1, 10, 50, 100};
+
+
+static void sleeper_task(void* arg)
+{
+    uint32_t nms = (uint32_t)(uintptr_t)arg;
+
+    while (true) {
+        tos_task_sleep(nms);
+    }
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_use_critical_section();
+    bench_stat_t stat;
+    uint32_t     sleepers = 0;
+
+    bench_report("\n%10s %12s %12s\n", "sleepers", "avg cycles", "max cycles");
+
+    for (int i = 0; i < util_arraylen(bench_sleeper_nums); i++) {
+        // sleepers wake up in random order, and never in the test
+        while (sleepers < bench_sleeper_nums[i]) {
+            uint32_t nms = 1000000u + (uint32_t)rand() % 1000000u;
+            bench_task_create(sleeper_task, (void*)(uintptr_t)nms, 1, "sleeper");
+            sleepers++;
+        }
+        tos_task_sleep(10);   // let sleepers go to sleep
+
+        bench_stat_reset(&stat);
+        for (int loop = 0; loop < BENCH_TICK_LOOPS; loop++) {
+            tos_enter_critical_section();
+            uint64_t start = bench_cycles();
+            tos_time_tick();
+            uint64_t end = bench_cycles();
+            tos_leave_critical_section();
+            bench_stat_add(&stat, end - start);
+        }
+        bench_report("%10d %12d %12d\n", sleepers, bench_stat_avg(&stat), (uint32_t)stat.max);
+    }
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
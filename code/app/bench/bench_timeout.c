@@ -0,0 +1,100 @@
+/**
+ * @file bench_timeout.c
+ * @brief cost of kernel timeouts: arm, cancel and expire vs number of pending timeouts
+ * @note then checks a timeout longer than TOS_TIMEOUT_TICKS_MAX is clamped, not expired at once, exits 1 if it's wrong
+ */
+
+#include "bench.h"
+#include "tos_core_.h"
+#include "tos_timeout_.h"
+
+
+#define BENCH_TIMEOUT_MAX   1000
+#define BENCH_TIMEOUT_LOOPS 10000
+#define BENCH_TIMEOUT_TICKS 2000   // timeouts are spread in it
+
+static const uint32_t bench_pending_nums[] = {10, 100, 1000};
+
+static tos_timeout_t bench_timeouts[BENCH_TIMEOUT_MAX + 1];
+static uint32_t      bench_expired;
+
+
+static void bench_timeout_proc(tos_timeout_t* timeout)
+{
+    bench_expired++;
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_use_critical_section();
+    bench_stat_t   arm_stat, cancel_stat;
+    tos_timeout_t* timeout = &bench_timeouts[BENCH_TIMEOUT_MAX];
+
+    bench_report("\n%10s %12s %12s %12s\n", "pending", "arm", "cancel", "expire");
+
+    tos_timeout_init(timeout, bench_timeout_proc);
+    for (int i = 0; i < util_arraylen(bench_pending_nums); i++) {
+        uint32_t pending = bench_pending_nums[i];
+
+        // no tick in the test, the pending timeouts stay
+        tos_enter_critical_section();
+
+        // arm/cancel one more timeout, like a timed lock acquired before deadline
+        for (int n = 0; n < pending; n++) {
+            tos_timeout_init(&bench_timeouts[n], bench_timeout_proc);
+            tos_timeout_arm(&bench_timeouts[n], 1 + (uint32_t)rand() % BENCH_TIMEOUT_TICKS);
+        }
+        bench_stat_reset(&arm_stat);
+        bench_stat_reset(&cancel_stat);
+        for (int loop = 0; loop < BENCH_TIMEOUT_LOOPS; loop++) {
+            uint32_t ticks = 1 + (uint32_t)rand() % BENCH_TIMEOUT_TICKS;
+
+            uint64_t start = bench_cycles();
+            tos_timeout_arm(timeout, ticks);
+            uint64_t end = bench_cycles();
+            bench_stat_add(&arm_stat, end - start);
+
+            start = bench_cycles();
+            tos_timeout_cancel(timeout);
+            end = bench_cycles();
+            bench_stat_add(&cancel_stat, end - start);
+        }
+
+        // expire all pending timeouts, cost per timeout including the ticks
+        bench_expired  = 0;
+        uint64_t start = bench_cycles();
+        for (int tick = 0; tick < BENCH_TIMEOUT_TICKS; tick++) {
+            tos_time_tick();
+        }
+        uint64_t end = bench_cycles();
+
+        tos_leave_critical_section();
+
+        bench_report("%10d %12d %12d %12d\n", pending, bench_stat_avg(&arm_stat), bench_stat_avg(&cancel_stat),
+                     (uint32_t)((end - start) / bench_expired));
+    }
+
+    // empty ticks are skipped by advance, the parked timeout is cascaded every wheel range
+    tos_enter_critical_section();
+    bench_expired = 0;
+    tos_timeout_arm(timeout, 0xFFFFFFF0u);
+    tos_timeout_advance(TOS_TIMEOUT_TICKS_MAX - 1);
+    uint32_t early = bench_expired;
+    tos_timeout_advance(1);
+    tos_leave_critical_section();
+
+    if (early != 0 || bench_expired != 1) {
+        bench_report("long timeout: wrong, expired %u before and %u at the max ticks\n", early, bench_expired - early);
+        exit(1);
+    }
+    bench_report("long timeout: ok\n");
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file bench_trace.c
+ * @brief cost of recording a kernel trace event, and its overhead on mutex lock/unlock
+ *
+ */
+
+#include "bench.h"
+#include "tos_mutex.h"
+#include "tos_trace_.h"
+
+
+#define BENCH_TRACE_NUM   100   // ops timed together, hide the cost of reading the cycle counter
+#define BENCH_TRACE_LOOPS 10000
+
+
+static tos_mutex_t bench_mutex;
+
+
+static uint32_t bench_record(void)
+{
+    bench_stat_t stat;
+
+    bench_stat_reset(&stat);
+    for (int loop = 0; loop < BENCH_TRACE_LOOPS; loop++) {
+        uint64_t start = bench_cycles();
+        for (int i = 0; i < BENCH_TRACE_NUM; i++) {
+            tos_trace(TOS_TRACE_MUTEX_LOCK, (uint16_t)i);
+        }
+        uint64_t end = bench_cycles();
+        bench_stat_add(&stat, (end - start) / BENCH_TRACE_NUM);
+    }
+
+    return bench_stat_avg(&stat);
+}
+
+
+static uint32_t bench_mutex_pair(void)
+{
+    bench_stat_t stat;
+
+    bench_stat_reset(&stat);
+    for (int loop = 0; loop < BENCH_TRACE_LOOPS; loop++) {
+        uint64_t start = bench_cycles();
+        for (int i = 0; i < BENCH_TRACE_NUM; i++) {
+            tos_mutex_lock(&bench_mutex);
+            tos_mutex_unlock(&bench_mutex);
+        }
+        uint64_t end = bench_cycles();
+        bench_stat_add(&stat, (end - start) / BENCH_TRACE_NUM);
+    }
+
+    return bench_stat_avg(&stat);
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_mutex_init(&bench_mutex, nullptr);
+
+    bench_report("\n%24s %12s\n", "op", "avg cycles");
+
+    tos_trace_stop();
+    bench_report("%24s %12d\n", "record, stopped", bench_record());
+    bench_report("%24s %12d\n", "mutex pair, stopped", bench_mutex_pair());
+
+    tos_trace_start(TOS_TRACE_MASK_ALL);
+    bench_report("%24s %12d\n", "record", bench_record());
+    bench_report("%24s %12d\n", "mutex pair, 2 records", bench_mutex_pair());
+
+    tos_mutex_destroy(&bench_mutex);
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file bench_work.c
+ * @brief deferred work of an ISR: tos_sem_give to a handler task vs tos_work_submit to the work task
+ * @note the irq is SIGUSR1 raised by a low prio task, cycles of the call in the ISR and from the ISR entry to the
+ *       handler running. median is reported too, the avg of host is skewed by the tick and by the host os
+ */
+
+#include <signal.h>
+
+#include "bench.h"
+#include "tos_cpu.h"
+#include "tos_sem.h"
+#include "tos_work.h"
+
+
+#define BENCH_WORK_LOOPS   20000
+#define BENCH_HANDLER_PRIO TOS_WORK_TASK_PRIO
+#define BENCH_RAISER_PRIO  2
+
+
+typedef enum {
+    BENCH_MODE_SEM = 0,
+    BENCH_MODE_WORK,
+    BENCH_MODE_NUM,
+} bench_mode_t;
+
+
+static const char* bench_mode_names[BENCH_MODE_NUM] = {"sem_give", "work_submit"};
+
+static tos_sem_t  bench_sem;
+static tos_work_t bench_work;
+
+static bench_mode_t      bench_mode;
+static volatile uint64_t bench_isr_cycles;
+static volatile bool     bench_done;
+static bench_stat_t      bench_call_stat;
+static bench_stat_t      bench_stat;
+static uint32_t          bench_samples[BENCH_WORK_LOOPS];
+
+
+static void bench_handle(void)
+{
+    uint64_t cycles = bench_cycles() - bench_isr_cycles;
+
+    bench_samples[bench_stat.count] = (uint32_t)cycles;
+    bench_stat_add(&bench_stat, cycles);
+    if (bench_stat.count == BENCH_WORK_LOOPS) {
+        bench_done = true;
+    }
+}
+
+
+static void bench_isr(void)
+{
+    uint64_t start;
+
+    tos_enter_isr();
+    start            = bench_cycles();
+    bench_isr_cycles = start;
+    if (bench_mode == BENCH_MODE_SEM) {
+        tos_sem_give(&bench_sem);
+    } else {
+        tos_work_submit(&bench_work);
+    }
+    bench_stat_add(&bench_call_stat, bench_cycles() - start);
+    tos_exit_isr();
+}
+
+
+static void bench_handler(void* arg)
+{
+    while (true) {
+        tos_sem_take(&bench_sem);
+        bench_handle();
+    }
+}
+
+
+static void bench_work_proc(void* arg)
+{
+    bench_handle();
+}
+
+
+static void bench_raiser(void* arg)
+{
+    while (!bench_done) {
+        raise(SIGUSR1);
+    }
+}
+
+
+static void bench_task(void* arg)
+{
+    tos_sem_init(&bench_sem, 0, nullptr);
+    tos_work_init(&bench_work, "bench", bench_work_proc, nullptr);
+    tos_cpu_irq_attach(SIGUSR1, bench_isr);
+    bench_task_create(bench_handler, nullptr, BENCH_HANDLER_PRIO, "handler");
+
+    bench_report("\n%12s %12s %12s %12s %12s\n", "op", "isr cycles", "median", "avg cycles", "max cycles");
+    for (bench_mode = 0; bench_mode < BENCH_MODE_NUM; bench_mode++) {
+        bench_done = false;
+        bench_stat_reset(&bench_call_stat);
+        bench_stat_reset(&bench_stat);
+
+        bench_task_create(bench_raiser, nullptr, BENCH_RAISER_PRIO, "raiser");
+        while (!bench_done) {
+            tos_task_sleep(1);
+        }
+        tos_task_sleep(10);   // raiser exits
+
+        bench_report("%12s %12u %12u %12u %12u\n", bench_mode_names[bench_mode], bench_stat_avg(&bench_call_stat),
+                     bench_stat_median(&bench_stat, bench_samples), bench_stat_avg(&bench_stat),
+                     (uint32_t)bench_stat.max);
+    }
+
+    exit(0);
+}
+
+
+int main()
+{
+    bench_start(bench_task);
+}
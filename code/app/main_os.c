@@ -2,17 +2,37 @@
 #include "tinyos.h"
 #include "utils.h"
 
-static tos_stack_t log_task_stack[512];
-static tos_stack_t cli_task_stack[512];
-static tos_stack_t usr1_task_stack[512];
-static tos_stack_t usr2_task_stack[512];
-static tos_stack_t usr3_task_stack[512];
+#ifdef TOS_PORT_POSIX
+#define APP_TASK_STACK_LEN (16 * 1024)
+#else
+#define APP_TASK_STACK_LEN 512
+#endif
+#define TOP_TASK_NUM_MAX   16
+#define TOP_NMS_DEFAULT    1000
+#define LAT_MUTEX_NUM_MAX  8
+#define LAT_WORK_NUM_MAX   8
+#define POOL_NUM_MAX       8
+
+static tos_stack_t log_task_stack[APP_TASK_STACK_LEN];
+static tos_stack_t cli_task_stack[APP_TASK_STACK_LEN];
+static tos_stack_t usr1_task_stack[APP_TASK_STACK_LEN];
+static tos_stack_t usr2_task_stack[APP_TASK_STACK_LEN];
+static tos_stack_t usr3_task_stack[APP_TASK_STACK_LEN];
+static tos_sem_storage_t cli_sem_storage;
+static tos_sem_t         cli_sem;   // given by console rx ISR
 
 static void bsp_init(void);
 static void service_init(void);
 static void log_task(void* arg);
 static void cli_task(void* arg);
+static void cli_rx_notify(void);
 static int  main_cmd_handler(int argc, char* argv[]);
+static int  top_cmd_handler(int argc, char* argv[]);
+static int  trace_cmd_handler(int argc, char* argv[]);
+static int  lat_cmd_handler(int argc, char* argv[]);
+static void lat_print_hist(const tos_hist_t* hist);
+static int  pool_cmd_handler(int argc, char* argv[]);
+static int  heap_cmd_handler(int argc, char* argv[]);
 static void usr1_task(void* arg);
 static void usr2_task(void* arg);
 static void usr3_task(void* arg);
@@ -23,6 +43,38 @@ static util_cli_item_t main_cli = {
     .entry = main_cmd_handler,
 };
 
+static util_cli_item_t top_cli = {
+    .cmd   = "top",
+    .help  = "top [nms], cpu usage of tasks in nms, 1000ms default",
+    .entry = top_cmd_handler,
+};
+
+static util_cli_item_t trace_cli = {
+    .cmd   = "trace",
+    .help  = "trace start [all] | stop | clear | dump, kernel event trace, all: with ticks",
+    .entry = trace_cmd_handler,
+};
+
+static util_cli_item_t lat_cli = {
+    .cmd   = "lat",
+    .help  = "wakeup-to-run latency of tasks and blocked time of mutexes, in us",
+    .entry = lat_cmd_handler,
+};
+
+static util_cli_item_t pool_cli = {
+    .cmd   = "pool",
+    .help  = "usage of fixed-block memory pools",
+    .entry = pool_cmd_handler,
+};
+
+static util_cli_item_t heap_cli = {
+    .cmd   = "heap",
+    .help  = "usage and fragmentation of the heap, sizes of mallocs",
+    .entry = heap_cmd_handler,
+};
+
+static tos_task_stat_t task_stats[TOP_TASK_NUM_MAX];
+
 tos_mutex_t mutex;
 tos_cond_t  cond;
 int         data = 0;
@@ -52,6 +104,7 @@ static void service_init(void)
     task.task_stack_size = sizeof(log_task_stack);
     task.task_prio       = 1;
     task.task_wait_time  = 0;
+    task.task_time_slice = 0;
     task.task_name       = "log";
     task.task_stack      = log_task_stack;
     tos_task_create(log_task, nullptr, &task);
@@ -59,6 +112,7 @@ static void service_init(void)
     task.task_stack_size = sizeof(cli_task_stack);
     task.task_prio       = 2;
     task.task_wait_time  = 0;
+    task.task_time_slice = 0;
     task.task_name       = "cli";
     task.task_stack      = cli_task_stack;
     tos_task_create(cli_task, nullptr, &task);
@@ -74,14 +128,29 @@ static void log_task(void* arg)
 
 static void cli_task(void* arg)
 {
+    tos_sem_attr_t sem_attr = {.sem_max = 1};   // one wakeup drains all input
+
     util_cli_init();
     util_cli_register(&main_cli);
+    util_cli_register(&top_cli);
+    util_cli_register(&trace_cli);
+    util_cli_register(&lat_cli);
+    util_cli_register(&pool_cli);
+    util_cli_register(&heap_cli);
+
+    tos_sem_init_static(&cli_sem, 0, &sem_attr, &cli_sem_storage);
+    uart_console_rx_notify(cli_rx_notify);
     while (true) {
         util_cli_process();
-        tos_task_sleep(5);
+        tos_sem_take(&cli_sem);
     }
 }
 
+static void cli_rx_notify(void)
+{
+    tos_sem_give(&cli_sem);
+}
+
 static int main_cmd_handler(int argc, char* argv[])
 {
     util_printf("main cmd handler\n");
@@ -96,6 +165,7 @@ static int main_cmd_handler(int argc, char* argv[])
         attr.task_stack_size = sizeof(usr1_task_stack);
         attr.task_prio       = 1;
         attr.task_wait_time  = 0;
+        attr.task_time_slice = 0;
         attr.task_name       = "usr1";
         attr.task_stack      = usr1_task_stack;
         tos_task_create(usr1_task, nullptr, &attr);
@@ -103,6 +173,7 @@ static int main_cmd_handler(int argc, char* argv[])
         attr.task_stack_size = sizeof(usr2_task_stack);
         attr.task_prio       = 1;
         attr.task_wait_time  = 0;
+        attr.task_time_slice = 0;
         attr.task_name       = "usr2";
         attr.task_stack      = usr2_task_stack;
         tos_task_create(usr2_task, nullptr, &attr);
@@ -110,6 +181,7 @@ static int main_cmd_handler(int argc, char* argv[])
         attr.task_stack_size = sizeof(usr3_task_stack);
         attr.task_prio       = 1;
         attr.task_wait_time  = 0;
+        attr.task_time_slice = 0;
         attr.task_name       = "usr3";
         attr.task_stack      = usr3_task_stack;
         tos_task_create(usr3_task, nullptr, &attr);
@@ -118,6 +190,177 @@ static int main_cmd_handler(int argc, char* argv[])
     return -1;
 }
 
+static int top_cmd_handler(int argc, char* argv[])
+{
+    static const char*     state_names[] = {"-", "run", "ready", "pend", "wait"};
+    static tos_task_stat_t stats_old[TOP_TASK_NUM_MAX];
+    tos_task_stat_t*       stats_new = task_stats;
+    uint64_t               cycles_old, cycles_new, cycles;
+    uint32_t               num_old, num_new, nms = TOP_NMS_DEFAULT;
+
+    if (argc == 2) {
+        nms = (uint32_t)atoi(argv[1]);
+    }
+    if (nms == 0) {
+        nms = TOP_NMS_DEFAULT;
+    }
+
+    num_old = tos_get_task_stats(stats_old, TOP_TASK_NUM_MAX, &cycles_old);
+    tos_task_sleep(nms);
+    num_new = tos_get_task_stats(stats_new, TOP_TASK_NUM_MAX, &cycles_new);
+    cycles  = cycles_new - cycles_old;
+
+    uint32_t load = tos_get_cpu_load();
+    util_printf("cpu load %u.%u%%, %u tasks, in %u ms\n", load / 10, load % 10, num_new, nms);
+    util_printf("%4s  %-15s %-5s %4s %4s %8s %6s\n", "id", "name", "state", "prio", "base", "switch/s", "cpu%");
+
+    for (uint32_t i = 0; i < num_new; i++) {
+        tos_task_stat_t* stat     = &stats_new[i];
+        uint32_t         switches = stat->task_switch_cnt;
+        uint64_t         run      = stat->task_run_cycles;
+        uint32_t         permille = 0;
+
+        // tasks created in the window start from 0
+        for (uint32_t j = 0; j < num_old; j++) {
+            if (stats_old[j].task == stat->task && stats_old[j].task_id == stat->task_id) {
+                switches -= stats_old[j].task_switch_cnt;
+                run -= stats_old[j].task_run_cycles;
+                break;
+            }
+        }
+        if (cycles > 0) {
+            permille = (uint32_t)(run * 1000 / cycles);
+        }
+
+        util_printf("%4u  %-15s %-5s %4u %4u %8u %4u.%u\n", stat->task_id, stat->task_name,
+                    state_names[stat->task_state], stat->task_prio, stat->task_base_prio,
+                    (uint32_t)((uint64_t)switches * 1000 / nms), permille / 10, permille % 10);
+    }
+
+    return 0;
+}
+
+static int trace_cmd_handler(int argc, char* argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+        bool all = (argc == 3 && strcmp(argv[2], "all") == 0);
+        tos_trace_start(all ? TOS_TRACE_MASK_ALL : TOS_TRACE_MASK_DEFAULT);
+    } else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        tos_trace_stop();
+    } else if (argc == 2 && strcmp(argv[1], "clear") == 0) {
+        tos_trace_clear();
+    } else if (argc == 2 && strcmp(argv[1], "dump") == 0) {
+        tos_trace_dump();
+    } else {
+        util_printf("usage: %s\n", trace_cli.help);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int lat_cmd_handler(int argc, char* argv[])
+{
+    static tos_mutex_stat_t mutex_stats[LAT_MUTEX_NUM_MAX];
+    static tos_work_stat_t  work_stats[LAT_WORK_NUM_MAX];
+    tos_hist_t              hist;
+    uint32_t                num, num_mutex, num_work;
+
+    util_printf("%4s  %-15s %8s %8s %8s %8s %8s\n", "id", "task", "wakeups", "p50", "p99", "p99.9", "max");
+    num = tos_get_task_stats(task_stats, TOP_TASK_NUM_MAX, nullptr);
+    for (uint32_t i = 0; i < num; i++) {
+        if (tos_get_task_latency(&task_stats[i].task, &hist) != 0) {
+            continue;
+        }
+        util_printf("%4u  %-15s ", task_stats[i].task_id, task_stats[i].task_name);
+        lat_print_hist(&hist);
+    }
+
+    util_printf("%-20s %-15s %8s %8s %8s %8s %8s\n", "mutex", "owner", "blocks", "p50", "p99", "p99.9", "max");
+    num_mutex = tos_get_mutex_stats(mutex_stats, LAT_MUTEX_NUM_MAX);
+    for (uint32_t i = 0; i < num_mutex; i++) {
+        const char* owner = "-";
+        for (uint32_t j = 0; j < num; j++) {
+            if (task_stats[j].task == mutex_stats[i].owner) {
+                owner = task_stats[j].task_name;
+            }
+        }
+        util_printf("%-20p %-15s ", (void*)mutex_stats[i].mutex, owner);
+        lat_print_hist(&mutex_stats[i].wait_hist);
+    }
+
+    util_printf("%-20s %-15s %8s %8s %8s %8s %8s\n", "work", "merged", "runs", "p50", "p99", "p99.9", "max");
+    num_work = tos_get_work_stats(work_stats, LAT_WORK_NUM_MAX);
+    for (uint32_t i = 0; i < num_work; i++) {
+        util_printf("%-20s %-15u ", work_stats[i].name, work_stats[i].busy_cnt);
+        lat_print_hist(&work_stats[i].latency);
+    }
+
+    return 0;
+}
+
+static void lat_print_hist(const tos_hist_t* hist)
+{
+    static const uint32_t permilles[] = {500, 990, 999};
+
+    util_printf("%8u", hist->total);
+    for (int i = 0; i < util_arraylen(permilles); i++) {
+        uint32_t cycles = tos_hist_percentile(hist, permilles[i]);
+        util_printf(" %8u", (uint32_t)((uint64_t)cycles * 1000000u / TOS_CPU_CYCLES_HZ));
+    }
+    util_printf(" %8u\n", (uint32_t)((uint64_t)hist->max * 1000000u / TOS_CPU_CYCLES_HZ));
+}
+
+static int pool_cmd_handler(int argc, char* argv[])
+{
+    static tos_mempool_stat_t pool_stats[POOL_NUM_MAX];
+    uint32_t                  num = tos_get_mempool_stats(pool_stats, POOL_NUM_MAX);
+
+    util_printf("%-20s %6s %8s %8s %8s %8s %8s\n", "pool", "owner", "blk size", "blocks", "used", "max", "fails");
+    for (uint32_t i = 0; i < num; i++) {
+        util_printf("%-20p %6s %8u %8u %8u %8u %8u\n", (void*)pool_stats[i].pool, pool_stats[i].kernel ? "kernel" : "user",
+                    pool_stats[i].blk_size, pool_stats[i].blk_num, pool_stats[i].used, pool_stats[i].used_max,
+                    pool_stats[i].fail_cnt);
+    }
+
+    return 0;
+}
+
+static int heap_cmd_handler(int argc, char* argv[])
+{
+    util_heap_stat_t stat;
+    uint32_t         num, cached = 0;
+    tos_use_critical_section();
+
+    // the heap is locked by tos_malloc/tos_free, not by itself
+    tos_enter_critical_section();
+    util_heap_stat(&stat);
+    tos_leave_critical_section();
+
+    num = tos_get_task_stats(task_stats, TOP_TASK_NUM_MAX, nullptr);
+    for (uint32_t i = 0; i < num; i++) {
+        cached += task_stats[i].task_cache_bytes;
+    }
+
+    util_printf("size %u, used %u, peak %u, cached by tasks %u\n", stat.heap_size, stat.used_size, stat.used_peak,
+                cached);
+    util_printf("free %u in %u blocks, largest %u, fragmentation %u.%u%%\n", stat.free_size, stat.free_blk_num,
+                stat.free_largest, stat.frag_permille / 10, stat.frag_permille % 10);
+    util_printf("mallocs %u, frees %u, fails %u\n", stat.alloc_cnt, stat.free_cnt, stat.fail_cnt);
+
+    util_printf("%8s", "size <=");
+    for (uint32_t i = 0; i < UTIL_HEAP_HIST_NUM - 1; i++) {
+        util_printf(" %6u", 16u << i);
+    }
+    util_printf(" %6s\n%8s", "more", "mallocs");
+    for (uint32_t i = 0; i < UTIL_HEAP_HIST_NUM; i++) {
+        util_printf(" %6u", stat.size_hist[i]);
+    }
+    util_printf("\n");
+
+    return 0;
+}
+
 static void usr1_task(void* arg)
 {
     static int counter = 1;
@@ -1,4 +1,5 @@
 #include "bsp.h"
+#include "tos_core.h"
 #include "util_ringbuffer.h"
 
 #include <stm32f10x.h>
@@ -21,6 +22,7 @@ static bool              uart_console_inited = false;
 static uint8_t           uart_console_data_buffer[UART_CONSOLE_BUFFER_SIZE];
 static util_ringbuffer_t uart_console_buffer;
 static uint8_t           group_prio_bits = 0;
+static void (*uart_console_notify)(void) = nullptr;   // rx callback
 
 static void nvic_priogroup_config(uint8_t group_bits)
 {
@@ -136,9 +138,15 @@ int uart_console_getc(void)
 }
 
 
+void uart_console_rx_notify(void (*notify)(void))
+{
+    uart_console_notify = notify;
+}
+
+
 void uart_console_isr(void)
 {
-    // tos_enter_isr();
+    tos_enter_isr();
     if (USART1->SR & (0x1u << 5)) {   // RXNE
         uint8_t data = USART1->DR;
 
@@ -146,7 +154,10 @@ void uart_console_isr(void)
             if (!util_ringbuffer_full(&uart_console_buffer)) {
                 util_ringbuffer_putc(&uart_console_buffer, data);
             }
+            if (uart_console_notify != nullptr) {
+                uart_console_notify();
+            }
         }
     }
-    // tos_exit_isr();
+    tos_exit_isr();   // the task notified is switched to here
 }
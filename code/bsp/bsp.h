@@ -10,6 +10,7 @@
 #define uart_console_putc        console_putc
 #define uart_console_getc        console_getc
 #define uart_console_init        console_init
+#define uart_console_rx_notify   console_rx_notify
 
 
 int  uart_console_init(uint32_t bound);
@@ -19,6 +20,13 @@ int  uart_console_putc(char c);
 int  uart_console_getc(void);
 void uart_console_isr(void);
 
+/**
+ * @brief set the callback of console rx, so readers can block instead of polling getc
+ *
+ * @param notify called in the rx ISR when data arrives, nullptr to remove
+ */
+void uart_console_rx_notify(void (*notify)(void));
+
 int sysirq_init(void);
 
 #endif
@@ -0,0 +1,132 @@
+/**
+ * @file bsp_posix.c
+ * @brief console of the linux/posix host, replace bsp.c in host build
+ *
+ */
+#include "bsp.h"
+#include "tos_core.h"
+#include "tos_cpu.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+static bool           uart_console_inited = false;
+static bool           console_raw_mode    = false;
+static struct termios console_saved_termios;
+static void (*uart_console_notify)(void) = nullptr;   // rx callback
+
+
+static void console_restore(void)
+{
+    if (console_raw_mode) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &console_saved_termios);
+        console_raw_mode = false;
+    }
+}
+
+
+static void console_exit_handler(int signo)
+{
+    console_restore();
+    _exit(128 + signo);
+}
+
+
+int sysirq_init(void)
+{
+    return 0;
+}
+
+
+int uart_console_init(uint32_t bound)
+{
+    // cli echoes input by itself, so disable the line mode and echo of the terminal
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &console_saved_termios) == 0) {
+        struct termios raw = console_saved_termios;
+
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN]  = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+        console_raw_mode = true;
+        atexit(console_restore);
+        signal(SIGINT, console_exit_handler);
+        signal(SIGTERM, console_exit_handler);
+    }
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+    // SIGIO plays the rx irq
+    tos_cpu_irq_attach(SIGIO, uart_console_isr);
+    fcntl(STDIN_FILENO, F_SETOWN, getpid());
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_ASYNC);
+
+    uart_console_inited = true;
+    uart_console_puts("\nuart init ok\n");
+    return 0;
+}
+
+
+int uart_console_put(const uint8_t* data, uint16_t len)
+{
+    if (uart_console_inited) {
+        while (len > 0) {
+            ssize_t n = write(STDOUT_FILENO, data, len);
+            if (n <= 0) {
+                return -1;
+            }
+            data += n;
+            len -= n;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+
+int uart_console_puts(const char* str)
+{
+    if (str != nullptr) {
+        return uart_console_put((const uint8_t*)str, (uint16_t)strlen(str));
+    }
+    return -1;
+}
+
+
+int uart_console_putc(char c)
+{
+    return uart_console_put((const uint8_t*)&c, 1);
+}
+
+
+int uart_console_getc(void)
+{
+    uint8_t c;
+
+    if (uart_console_inited && read(STDIN_FILENO, &c, 1) == 1) {
+        return (c == 0x7F) ? '\b' : (int)c;   // backspace of terminal is DEL
+    }
+    return -1;
+}
+
+
+void uart_console_rx_notify(void (*notify)(void))
+{
+    uart_console_notify = notify;
+}
+
+
+void uart_console_isr(void)
+{
+    // data stays in stdin until uart_console_getc reads it
+    tos_enter_isr();
+    if (uart_console_notify != nullptr) {
+        uart_console_notify();
+    }
+    tos_exit_isr();
+}
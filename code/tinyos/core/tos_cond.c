@@ -4,10 +4,13 @@
  * @note
  */
 #include "tos_cond.h"
+#include "tos_cond_.h"
 #include "tos_config.h"
 #include "tos_core.h"
 #include "tos_core_.h"
 #include "tos_mem.h"
+#include "tos_mutex_.h"
+#include "tos_trace_.h"
 #include "util_misc.h"
 #include "util_queue.h"
 
@@ -15,13 +18,8 @@
 #define COND_INVALID_FLAG 0xFFFFFFFF
 
 
-typedef struct tos_cond_intenal_t {
-    uint32_t          valid_flag;
-    uint16_t          use_count;
-    uint16_t          value;
-    util_queue_node_t waiting_list;
-    util_queue_node_t queue_link;   // link conds into list
-} tos_cond_intenal_t;
+static void tos_cond_setup(tos_cond_intenal_t* cond_intenal, bool is_static);
+static bool tos_cond_check(tos_cond_intenal_t* cond_intenal);
 
 
 /**
@@ -45,11 +43,28 @@ int tos_cond_init(tos_cond_t* cond, const tos_cond_attr_t* attr)
     }
 
     *cond = cond_intenal;
+    tos_cond_setup(cond_intenal, false);
 
-    cond_intenal->valid_flag = COND_VALID_FLAG;
-    cond_intenal->value      = 0;
-    cond_intenal->use_count  = 0;
-    util_queue_init(&(cond_intenal->waiting_list));
+    return 0;
+}
+
+
+/**
+ * @brief init cond in the storage given by caller, the heap is not used
+ *
+ * @param cond
+ * @param attr
+ * @param storage static or global storage, alive until the cond is destroyed
+ * @return int
+ */
+int tos_cond_init_static(tos_cond_t* cond, const tos_cond_attr_t* attr, tos_cond_storage_t* storage)
+{
+    if (cond == nullptr || storage == nullptr) {
+        return TOS_ERR_COND_NULLPTR;
+    }
+
+    *cond = storage;
+    tos_cond_setup(storage, true);
 
     return 0;
 }
@@ -91,7 +106,7 @@ int tos_cond_waitfor(tos_cond_t* cond, tos_mutex_t* mutex, uint32_t try_nms)
     }
     tos_cond_intenal_t* cond_intenal = *cond;
 
-    if (cond_intenal->valid_flag != COND_VALID_FLAG) {
+    if (!tos_cond_check(cond_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_COND_INVALID;
     }
@@ -126,28 +141,31 @@ int tos_cond_waitfor(tos_cond_t* cond, tos_mutex_t* mutex, uint32_t try_nms)
     // wait cond
     // add current task to pending list
     tos_task_tcb_t* current_task = tos_get_current_task();
-    util_queue_remove(&current_task->ready_pending_link);
-    if (util_queue_empty(&tos_state.ready_task_list[current_task->task_prio])) {
-        tos_state.ready_task_prio_mask &= ~current_task->task_prio_mask;
-    }
-    util_queue_insert(&cond_intenal->waiting_list, &current_task->ready_pending_link);
+    tos_trace(TOS_TRACE_COND_WAIT, tos_trace_obj(cond_intenal));
+    tos_ready_list_remove(current_task);
+    tos_wait_queue_insert(&cond_intenal->waiting_list, current_task);
+    current_task->task_wait_data = *mutex;   // waiters may use different mutexes, each is requeued to its own
 
     // add current task into waiting list
     if (try_nms != TOS_COND_WAIT_INFINITE) {
-        current_task->task_wait_time = try_nms / TOS_TICK_MS;
-        util_queue_insert(&tos_state.waiting_task_list, &current_task->waiting_link);
+        tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
     }
     tos_leave_critical_section();
 
     tos_schedule();
 
     tos_enter_critical_section();
+    current_task->task_wait_data = nullptr;
 
-    // cond satisfied
+    // cond satisfied, the mutex has been locked for current task when notified,
+    // unless it is notified after timeout
     if (value != cond_intenal->value) {
         cond_intenal->use_count--;
+        bool locked = (tos_mutex_owner(*mutex) == current_task);
         tos_leave_critical_section();
-        tos_mutex_lock(mutex);
+        if (!locked) {
+            tos_mutex_lock(mutex);
+        }
         return 0;
     } else {
         cond_intenal->use_count--;
@@ -179,38 +197,25 @@ int tos_cond_signal(tos_cond_t* cond)
     tos_cond_intenal_t* cond_intenal = *cond;
 
     // cond is invalid
-    if (cond_intenal->valid_flag != COND_VALID_FLAG) {
+    if (!tos_cond_check(cond_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_COND_INVALID;
     }
 
     cond_intenal->value++;
+    tos_trace(TOS_TRACE_COND_SIGNAL, tos_trace_obj(cond_intenal));
 
     // waiting list is empty
-    if (util_queue_empty(&cond_intenal->waiting_list)) {
+    if (tos_wait_queue_empty(&cond_intenal->waiting_list)) {
         tos_leave_critical_section();
         return 0;
     }
 
-    // find task with highest prio
-    tos_task_tcb_t*    hignest_prio_task = nullptr;
-    uint8_t            hignest_prio      = 0;
-    util_queue_node_t* queue_node        = cond_intenal->waiting_list.next;
-    while (queue_node != &cond_intenal->waiting_list) {
-        tos_task_tcb_t* next_task = get_task_by_ready_pending_link(queue_node);
-        if (next_task->task_prio > hignest_prio) {
-            hignest_prio_task = next_task;
-            hignest_prio      = next_task->task_prio;
-        }
-        queue_node = queue_node->next;
-    }
-    if (hignest_prio_task != nullptr) {
-        util_queue_remove(&hignest_prio_task->ready_pending_link);   // in blocking list now
-        util_queue_remove(&hignest_prio_task->waiting_link);
-        util_queue_insert(&tos_state.ready_task_list[hignest_prio_task->task_prio],
-                          &hignest_prio_task->ready_pending_link);
-        tos_state.ready_task_prio_mask |= hignest_prio_task->task_prio_mask;
-    }
+    // wakeup task with highest prio, it waits for the mutex directly
+    tos_task_tcb_t* hignest_prio_task = tos_wait_queue_first(&cond_intenal->waiting_list);
+    tos_wait_queue_remove(hignest_prio_task);
+    tos_waiting_list_remove(hignest_prio_task);
+    tos_mutex_lock_for((tos_mutex_intenal_t*)hignest_prio_task->task_wait_data, hignest_prio_task);
 
     tos_leave_critical_section();
 
@@ -241,26 +246,27 @@ int tos_cond_broadcast(tos_cond_t* cond)
     }
     tos_cond_intenal_t* cond_intenal = *cond;
 
-    if (cond_intenal->valid_flag != COND_VALID_FLAG) {
+    if (!tos_cond_check(cond_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_COND_INVALID;
     }
 
     cond_intenal->value++;
+    tos_trace(TOS_TRACE_COND_BROADCAST, tos_trace_obj(cond_intenal));
 
     // waiting list is empty
-    if (util_queue_empty(&cond_intenal->waiting_list)) {
+    if (tos_wait_queue_empty(&cond_intenal->waiting_list)) {
         tos_leave_critical_section();
         return 0;
     }
 
-    // notify all task
-    while (!util_queue_empty(&cond_intenal->waiting_list)) {
-        tos_task_tcb_t* next_task = get_task_by_ready_pending_link(cond_intenal->waiting_list.next);
-        util_queue_remove(&next_task->ready_pending_link);   // in blocking list now
-        util_queue_remove(&next_task->waiting_link);
-        util_queue_insert(&tos_state.ready_task_list[next_task->task_prio], &next_task->ready_pending_link);
-        tos_state.ready_task_prio_mask |= next_task->task_prio_mask;
+    // notify all task, move them to pending list of their mutexes (wait morphing),
+    // only the one gets the mutex will be ready
+    while (!tos_wait_queue_empty(&cond_intenal->waiting_list)) {
+        tos_task_tcb_t* next_task = tos_wait_queue_first(&cond_intenal->waiting_list);
+        tos_wait_queue_remove(next_task);
+        tos_waiting_list_remove(next_task);
+        tos_mutex_lock_for((tos_mutex_intenal_t*)next_task->task_wait_data, next_task);
     }
     tos_leave_critical_section();
 
@@ -292,7 +298,7 @@ int tos_cond_destroy(tos_cond_t* cond)
 
     tos_cond_intenal_t* cond_intenal = *cond;
 
-    if (cond_intenal->valid_flag != COND_VALID_FLAG) {
+    if (!tos_cond_check(cond_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_COND_INVALID;
     }
@@ -307,9 +313,44 @@ int tos_cond_destroy(tos_cond_t* cond)
 
     tos_leave_critical_section();
 
-    tos_free(cond_intenal);
+    if (!cond_intenal->is_static) {
+        tos_free(cond_intenal);
+    }
 
     *cond = nullptr;
 
     return 0;
 }
+
+
+/**
+ * @brief init cond in its storage
+ *
+ * @param cond_intenal
+ * @param is_static
+ */
+static void tos_cond_setup(tos_cond_intenal_t* cond_intenal, bool is_static)
+{
+    cond_intenal->value      = 0;
+    cond_intenal->use_count  = 0;
+    cond_intenal->is_static  = is_static;
+    tos_wait_queue_init(&(cond_intenal->waiting_list));
+    cond_intenal->valid_flag = COND_VALID_FLAG;
+}
+
+
+/**
+ * @brief check cond, the one by TOS_COND_INITIALIZER is setup at its first use
+ *
+ * @param cond_intenal
+ * @return true if valid
+ * @note called in critical section
+ */
+static bool tos_cond_check(tos_cond_intenal_t* cond_intenal)
+{
+    if (cond_intenal->valid_flag == COND_INITIALIZER_FLAG) {
+        tos_cond_setup(cond_intenal, true);
+    }
+
+    return cond_intenal->valid_flag == COND_VALID_FLAG;
+}
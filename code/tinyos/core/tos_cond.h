@@ -25,6 +25,7 @@
 
 
 typedef struct tos_cond_intenal_t* tos_cond_t;
+typedef struct tos_cond_intenal_t  tos_cond_storage_t;   // storage for tos_cond_init_static, see tos_static.h
 typedef struct {
     uint8_t resv;
 } tos_cond_attr_t;
@@ -39,6 +40,16 @@ typedef struct {
  */
 int tos_cond_init(tos_cond_t* cond, const tos_cond_attr_t* attr);
 
+/**
+ * @brief init cond in the storage given by caller, the heap is not used
+ *
+ * @param cond
+ * @param attr
+ * @param storage
+ * @return int
+ */
+int tos_cond_init_static(tos_cond_t* cond, const tos_cond_attr_t* attr, tos_cond_storage_t* storage);
+
 /**
  * @brief
  *
@@ -0,0 +1,30 @@
+/**
+ * @file tos_cond_.h
+ * @brief condition variable
+ * @note private, not for user
+ */
+
+#ifndef _TOS_COND__H_
+#define _TOS_COND__H_
+
+
+#include "tos_cond.h"
+#include "tos_core_.h"
+#include "tos_mutex_.h"
+#include "util_queue.h"
+
+
+#define COND_INITIALIZER_FLAG 0xA5A5A5A5u   // valid_flag by TOS_COND_INITIALIZER, setup at the first use
+
+
+typedef struct tos_cond_intenal_t {
+    uint32_t          valid_flag;
+    uint16_t          use_count;
+    uint16_t          value;
+    tos_wait_queue_t  waiting_list;
+    util_queue_node_t queue_link;   // link conds into list
+    bool              is_static;    // storage is given by user, not freed by destroy
+} tos_cond_intenal_t;
+
+
+#endif
@@ -16,14 +16,87 @@
 
 // task config
 #define TOS_TASK_NAME_LEN_MAX   16
-#define TOS_MAX_PRIO_NUM_USED   8   // max prio is 31
+#define TOS_MAX_PRIO_NUM_USED   8   // max prio is 255
 #define TOS_MAX_TASK_NUM_USED   8   // without limit
+#ifdef TOS_PORT_POSIX
+#define TOS_IDLETASK_STACK_SIZE (64 * 1024)   // host task context and signal frame need much more stack
+#else
 #define TOS_IDLETASK_STACK_SIZE 512
+#endif
+#define TOS_TIME_SLICE_ENABLE   1    // round-robin among tasks with same prio
+#define TOS_TIME_SLICE_DEFAULT  10   // ticks, used when task_time_slice of attr is 0
+
+// software timer, callbacks run in the timer service task. at the highest prio they preempt all other tasks,
+// keep them short, or lower the prio and accept callbacks delayed by the tasks above it
+#define TOS_TIMER_ENABLE        1
+#define TOS_TIMER_TASK_PRIO     TOS_MAX_PRIO_NUM_USED
+#ifdef TOS_PORT_POSIX
+#define TOS_TIMER_TASK_STACK_SIZE (64 * 1024)
+#else
+#define TOS_TIMER_TASK_STACK_SIZE 1024
+#endif
+
+// deferred work of ISRs, run by the work task, see tos_work.h
+#define TOS_WORK_ENABLE         1
+#define TOS_WORK_TASK_PRIO      TOS_MAX_PRIO_NUM_USED
+#ifdef TOS_PORT_POSIX
+#define TOS_WORK_TASK_STACK_SIZE (64 * 1024)
+#else
+#define TOS_WORK_TASK_STACK_SIZE 1024
+#endif
+
+// kernel objects from fixed-block pools instead of the heap, the heap is used when they are too large or pools are empty
+#define TOS_MEMPOOL_KERNEL_ENABLE 1
+#ifdef TOS_PORT_POSIX
+#define TOS_MEMPOOL_KERNEL_CLASSES {128, 8}, {256, 8}, {384, 8}   // {block size, block num}, ascending
+#else
+#define TOS_MEMPOOL_KERNEL_CLASSES {64, 8}, {128, 8}, {256, 4}
+#endif
+
+// per-task cache of heap blocks, a task gets back what it freed recently without the critical section of the heap
+#define TOS_TASK_CACHE_ENABLE    1
+#define TOS_TASK_CACHE_SIZE_MAX  512    // larger ones always go to the heap
+#define TOS_TASK_CACHE_CLASS_NUM 8      // size classes, TOS_TASK_CACHE_SIZE_MAX / TOS_TASK_CACHE_CLASS_NUM apart
+#define TOS_TASK_CACHE_BYTES_MAX 1024   // the whole cache of a task is flushed to the heap when it would hold more
+// when the heap is exhausted only the cache of the allocating task is flushed, each other task may still keep up to
+// TOS_TASK_CACHE_BYTES_MAX out of the heap, count it in when sizing the heap
+
+// cpu time accounting of tasks by the cycle counter of port, cpu load is updated every second
+#define TOS_CPU_STAT_ENABLE     1
+
+// log2 histograms of wakeup-to-run latency of tasks and blocked time of mutexes, in cycles
+#define TOS_LATENCY_STAT_ENABLE 1
+#define TOS_HIST_BUCKETS        24   // the last bucket holds all above 2^(TOS_HIST_BUCKETS-2) cycles
+
+// kernel event trace, see tos_trace.h
+#define TOS_TRACE_ENABLE        1
+#ifdef TOS_PORT_POSIX
+#define TOS_TRACE_BUF_SIZE      4096   // records, 8 bytes each, power of 2
+#else
+#define TOS_TRACE_BUF_SIZE      256
+#endif
+#define TOS_TRACE_MASK_DEFAULT  (TOS_TRACE_MASK_ALL & ~tos_trace_bit(TOS_TRACE_TICK))   // recording from boot
 
 // clock config
 #define TOS_SYS_HZ              1000u
 #define TOS_TICK_MS             (1000u / TOS_SYS_HZ)
 #define TOS_TIME_WAIT_INFINITY  0xFFFFFFFFu
+#if defined(TOS_PORT_POSIX)
+#define TOS_CPU_CYCLES_HZ       1000000u   // tos_cpu_cycles is in us on host
+#elif defined(__CCRH__)
+#define TOS_CPU_CYCLES_HZ       TOS_SYS_HZ   // tos_cpu_cycles falls back to sys ticks on rh850
+#else
+#define TOS_CPU_CYCLES_HZ       MCU_SYS_CLOCK
+#endif
+#define TOS_TIMEOUT_WHEEL_LEVELS 4   // 32 slots per level, 32^4 ticks before a timeout is re-parked
+
+// tickless idle: stop the periodic tick and sleep the cpu when all tasks are waiting
+#ifdef TOS_PORT_POSIX
+#define TOS_TICKLESS_ENABLE     1
+#else
+#define TOS_TICKLESS_ENABLE     0
+#endif
+#define TOS_TICKLESS_MIN_TICKS  2   // keep the tick if idle time is shorter
 #define MCU_SYS_CLOCK           72000000u   // 72 MHz
 
 #endif
@@ -10,14 +10,37 @@
 #include "tos_config.h"
 #include "tos_core_.h"
 #include "tos_mem.h"
+#include "tos_mempool_.h"
+#include "tos_mutex_.h"
+#include "tos_taskcache_.h"
+#include "tos_timeout_.h"
+#include "tos_timer_.h"
+#include "tos_trace_.h"
+#include "tos_work_.h"
 #include "util_log.h"
 #include "util_misc.h"
 
 
-static uint32_t        tos_get_highest_prio(uint32_t prio_mask);
+static uint32_t        tos_get_highest_prio(void);
 static void            tos_idle_task_proc(void* args);
+static void            tos_time_advance(uint32_t ticks);
+static void            tos_task_timeout_proc(tos_timeout_t* timeout);
+static void            tos_task_switch_prepare(void);
+#if TOS_CPU_STAT_ENABLE
+static void            tos_cpu_account(void);
+static void            tos_cpu_load_update(void);
+#endif
+#if TOS_TIME_SLICE_ENABLE
+static void            tos_time_slice_tick(void);
+#endif
+#if TOS_TICKLESS_ENABLE
+static void            tos_tickless_idle(void);
+#endif
+static tos_task_t      tos_task_create_at(tos_task_proc_t proc, void* args, tos_task_attr_t* attr,
+                                          tos_task_tcb_t* storage);
 static tos_task_tcb_t* tos_get_free_tcb(void);
-static tos_task_tcb_t* tos_task_tcb_init(tos_task_attr_t* attr, tos_stack_t* task_stack_ptr);
+static void            tos_put_free_tcb(tos_task_tcb_t* tcb);
+static tos_task_tcb_t* tos_task_tcb_init(tos_task_attr_t* attr, tos_stack_t* task_stack_ptr, tos_task_tcb_t* storage);
 
 
 uint32_t           tos_task_prio_current;                                                // task core cpu
@@ -26,6 +49,7 @@ tos_task_tcb_t*    tos_task_current;
 tos_task_tcb_t*    tos_task_switch_to;                                                   //
 tos_run_state_t    tos_state = {0};                                                      //
 static tos_stack_t tos_idle_task_stack[TOS_IDLETASK_STACK_SIZE / sizeof(tos_stack_t)];   //
+static tos_task_tcb_t tos_idle_task_tcb;                                                 //
 
 
 bool tos_init(void)
@@ -35,6 +59,12 @@ bool tos_init(void)
 
     tos_irq_diable();   // irq will be enable in tos_start
 
+#if TOS_MEMPOOL_KERNEL_ENABLE
+    if (!tos_mempool_kernel_init()) {
+        return false;
+    }
+#endif
+
     // state init
     tos_task_current          = nullptr;
     tos_task_prio_current     = 0;
@@ -43,26 +73,50 @@ bool tos_init(void)
     tos_state.sys_running     = false;
     tos_state.sys_ticks       = 0;
     tos_state.task_number     = 0;
-
-    // init ready_list, waiting_list, all_list
-    tos_state.ready_task_prio_mask = 0;
+#if TOS_CPU_STAT_ENABLE
+    tos_state.cpu_cycles       = 0;
+    tos_state.cpu_load         = 0;
+    tos_state.load_ticks       = 0;
+    tos_state.load_cycles      = 0;
+    tos_state.load_idle_cycles = 0;
+#endif
+
+    // init ready_list, all_list, timing wheel
+    tos_prio_bitmap_init(&tos_state.ready_prio_map);
     for (index = 0; index <= TOS_MAX_PRIO_NUM_USED; index++) {
         util_queue_init(&tos_state.ready_task_list[index]);
     }
-    util_queue_init(&tos_state.waiting_task_list);
     util_queue_init(&tos_state.all_task_list);
+    tos_timeout_wheel_init();
 
     // create idle task
     task_attr.task_name       = "idle";
     task_attr.task_wait_time  = 0;
+    task_attr.task_time_slice = 0;
     task_attr.task_prio       = 0;   // lowest prio
     task_attr.task_stack_size = TOS_IDLETASK_STACK_SIZE;
     task_attr.task_stack      = tos_idle_task_stack;
 
-    if (tos_task_create(tos_idle_task_proc, nullptr, &task_attr) == nullptr) {
+    tos_task_t idle_task = tos_task_create_static(tos_idle_task_proc, nullptr, &task_attr, &tos_idle_task_tcb);
+    if (idle_task == nullptr) {
         // tos_error("idle task create error!");
         return false;
     }
+#if TOS_CPU_STAT_ENABLE
+    tos_state.idle_task = idle_task;
+#endif
+
+#if TOS_TIMER_ENABLE
+    if (!tos_timer_init()) {
+        return false;
+    }
+#endif
+
+#if TOS_WORK_ENABLE
+    if (!tos_work_task_init()) {
+        return false;
+    }
+#endif
 
     return true;
 }
@@ -72,13 +126,16 @@ void tos_start(void)
 {
     util_printk(TOS_BANNER);
 
-    tos_task_prio_switch_to = tos_get_highest_prio(tos_state.ready_task_prio_mask);
+    tos_task_prio_switch_to = tos_get_highest_prio();
     tos_task_switch_to      = get_task_by_ready_pending_link(tos_state.ready_task_list[tos_task_prio_switch_to].next);
 
     tos_state.sys_running     = true;
     tos_state.schedule_enable = true;
 
-    tos_task_switch_to->task_switch_cnt++;
+#if TOS_CPU_STAT_ENABLE
+    tos_state.cpu_cycles_stamp = tos_cpu_cycles();
+#endif
+    tos_task_switch_prepare();
 
     tos_sys_clock_init();   // tos sys tick clock init
 
@@ -103,6 +160,7 @@ void tos_enter_isr(void)
         if (tos_state.intr_level < 255) {
             tos_state.intr_level++;
         }
+        tos_trace(TOS_TRACE_ISR_ENTER, tos_state.intr_level);
     }
 
     tos_leave_critical_section();
@@ -118,14 +176,15 @@ void tos_exit_isr(void)
 
         if (tos_state.intr_level > 0)
             tos_state.intr_level--;
+        tos_trace(TOS_TRACE_ISR_EXIT, tos_state.intr_level);
 
         // schedule when all intr exit
         if (tos_state.intr_level == 0 && tos_state.schedule_enable == true) {
-            tos_task_prio_switch_to = tos_get_highest_prio(tos_state.ready_task_prio_mask);
+            tos_task_prio_switch_to = tos_get_highest_prio();
             tos_task_switch_to      = get_task_by_ready_pending_link(tos_state.ready_task_list[tos_task_prio_switch_to].next);
 
             if (tos_task_switch_to != tos_task_current) {
-                tos_task_switch_to->task_switch_cnt++;
+                tos_task_switch_prepare();
                 tos_task_switch_intr();
             }
         }
@@ -161,45 +220,24 @@ void tos_schedule_disable(void)
 
 tos_task_t tos_task_create(tos_task_proc_t proc, void* args, tos_task_attr_t* attr)
 {
-    tos_use_critical_section();
-
-    if (attr == nullptr || attr->task_stack == nullptr) {
-        return nullptr;
-    }
-
-    tos_enter_critical_section();
-    if (tos_state.intr_level > 0) {
-        tos_leave_critical_section();
-        return nullptr;
-    }
-
-    tos_leave_critical_section();
-
-    tos_stack_t* stack_end = &attr->task_stack[(attr->task_stack_size / sizeof(tos_stack_t))];
-
-    util_printk("create %15s: [%p, %p) %4d Bytes.\n", attr->task_name, attr->task_stack, stack_end,
-                attr->task_stack_size);
+    return tos_task_create_at(proc, args, attr, nullptr);
+}
 
-    tos_stack_t*    task_stack_ptr = tos_task_stack_frame_init(proc, args, stack_end - 1);
-    tos_task_tcb_t* tcb            = tos_task_tcb_init(attr, task_stack_ptr);
 
-    if (tcb == nullptr) {
-        // tos_error("try to create task(%s, id=%d) error", attr->task_name, tos_state.task_number + 1);
+tos_task_t tos_task_create_static(tos_task_proc_t proc, void* args, tos_task_attr_t* attr, tos_task_storage_t* storage)
+{
+    if (storage == nullptr) {
         return nullptr;
     }
 
-    if (tos_state.sys_running) {
-        tos_schedule();
-    }
-
-    return tcb;
+    return tos_task_create_at(proc, args, attr, storage);
 }
 
 
-void tos_task_delete(tos_task_t* task)
+int32_t tos_task_delete(tos_task_t* task)
 {
     if (task == nullptr)
-        return;
+        return -1;
 
     tos_task_tcb_t* tcb = *task;
 
@@ -207,18 +245,34 @@ void tos_task_delete(tos_task_t* task)
 
     // if (tos_state.intr_level > 0 || tcb == tos_task_current)
     if (tos_state.intr_level > 0) {
-        return;
+        return -1;
     }
 
     tos_enter_critical_section();
 
-    // remove task from read_pending list
-    util_queue_remove(&tcb->ready_pending_link);
-    if (util_queue_empty(&tos_state.ready_task_list[tcb->task_prio])) {
-        tos_state.ready_task_prio_mask &= ~tcb->task_prio_mask;
+    // messages of msgq after the ones in its hands would never be published
+    if (tcb->task_msgq_held != 0) {
+        tos_leave_critical_section();
+        return -1;
+    }
+
+    tos_trace(TOS_TRACE_TASK_DELETE, tcb->task_id);
+
+    // remove task from ready list or wait queue
+    if (tcb->task_wait_queue != nullptr) {
+        tos_wait_queue_remove(tcb);
+    } else {
+        tos_ready_list_remove(tcb);
     }
     // remove task from waiting list
-    util_queue_remove(&tcb->waiting_link);
+    tos_waiting_list_remove(tcb);
+    // the owner may inherit prio from this task
+    if (tcb->task_state == TOS_TASK_STATE_PENDING && tcb->task_pending_mutex != nullptr) {
+        tos_mutex_prio_update(tos_mutex_owner(tcb->task_pending_mutex));
+    }
+    tcb->task_pending_mutex = nullptr;
+    // no mutex owner word may point to the tcb, hand them over to the waiters
+    bool woken = tos_mutex_release_all(tcb);
 
     // remove task from all_task list
     tos_state.task_number--;
@@ -226,8 +280,21 @@ void tos_task_delete(tos_task_t* task)
 
     tos_leave_critical_section();
 
-    tos_free(tcb);
+    // a self-deleting task is switched out by its caller
+    if (woken && tcb != tos_task_current) {
+        tos_schedule();
+    }
+
+#if TOS_TASK_CACHE_ENABLE
+    // it's not running or it's deleting itself, its cache is not touched by others
+    tos_task_cache_flush(tcb);
+#endif
+    if ((tcb->task_flag & TOS_TASK_FLAG_STATIC) == 0) {
+        tos_put_free_tcb(tcb);
+    }
     *task = nullptr;
+
+    return 0;
 }
 
 
@@ -240,44 +307,34 @@ int32_t tos_set_task_prio(tos_task_t* task, uint32_t prio)
 
     tos_use_critical_section();
 
-    uint8_t prio_old = tcb->task_prio;
+    uint8_t prio_old = tcb->task_base_prio;
 
-    if (prio == tcb->task_prio) {
+    if (prio == tcb->task_base_prio || prio > TOS_MAX_PRIO_NUM_USED) {
         return -1;
     }
 
-    // running or ready task, in read_pending list
-    if (tcb->task_state == TOS_TASK_STATE_RUNNING || tcb->task_state == TOS_TASK_STATE_READY) {
-        tos_enter_critical_section();
-
-        // remove from old list
-        util_queue_remove(&tcb->ready_pending_link);
-        if (util_queue_empty(&tos_state.ready_task_list[tcb->task_prio])) {
-            tos_state.ready_task_prio_mask &= ~tcb->task_prio_mask;
-        }
+    tos_enter_critical_section();
 
-        // add into new list
-        util_queue_insert(&tos_state.ready_task_list[prio], &tcb->ready_pending_link);
-        tos_state.ready_task_prio_mask |= 1 << prio;
+    // the running prio keeps the prio inherited from mutex waiters
+    tcb->task_base_prio = prio;
+    tos_mutex_prio_update(tcb);
 
-        tos_leave_critical_section();
-    }
+    tos_leave_critical_section();
 
-    // sleep or block task, in waiting or sem list, modify prio immediately
-    tcb->task_prio      = prio;
-    tcb->task_prio_mask = 1 << prio;
+    tos_schedule();
 
-    if (tcb == tos_task_current) {
-        tos_enter_critical_section();
+    return prio_old;
+}
 
-        tos_task_prio_current = tcb->task_prio_mask;
 
-        tos_leave_critical_section();
-    }
+void tos_set_task_time_slice(tos_task_t* task, uint32_t ticks)
+{
+    if (task == nullptr)
+        return;
 
-    tos_schedule();
+    tos_task_tcb_t* tcb = *task;
 
-    return prio_old;
+    tcb->task_time_slice = (ticks == 0) ? TOS_TIME_SLICE_DEFAULT : ticks;
 }
 
 
@@ -316,14 +373,13 @@ void tos_task_sleep(uint32_t nms)
 
     tos_enter_critical_section();
 
-    util_queue_remove(&tos_task_current->ready_pending_link);
-    if (util_queue_empty(&tos_state.ready_task_list[tos_task_current->task_prio])) {
-        tos_state.ready_task_prio_mask &= ~tos_task_current->task_prio_mask;
-    }
+    tos_ready_list_remove(tos_task_current);
     util_queue_init(&tos_task_current->ready_pending_link);
+    tos_task_current->task_state = TOS_TASK_STATE_WAITING;
 
-    tos_task_current->task_wait_time = nms / TOS_TICK_MS;
-    util_queue_insert(&tos_state.waiting_task_list, &tos_task_current->waiting_link);
+    if (nms != TOS_TIME_WAIT_INFINITY) {
+        tos_waiting_list_insert(tos_task_current, nms / TOS_TICK_MS);
+    }
 
     tos_leave_critical_section();
 
@@ -359,38 +415,171 @@ tos_task_tcb_t* tos_get_current_task(void)
 }
 
 
-void tos_time_tick(void)
+uint32_t tos_get_task_stats(tos_task_stat_t* stats, uint32_t num, uint64_t* cycles)
 {
-    util_queue_node_t* list_node;
-    util_queue_node_t* list_next;
-    tos_task_tcb_t*    tcb;
+    uint32_t count = 0;
     tos_use_critical_section();
 
-    tos_state.sys_ticks++;
+    if (stats == nullptr) {
+        return 0;
+    }
+
     tos_enter_critical_section();
 
-    // travel the time wait list
-    for (list_node = tos_state.waiting_task_list.next; list_node != &tos_state.waiting_task_list; list_node = list_next) {
-        tcb       = get_task_by_waiting_link(list_node);
-        list_next = list_node->next;   // NOTICE: list link maybe changed in the loop
+#if TOS_CPU_STAT_ENABLE
+    // charge the running task to now
+    if (tos_state.sys_running) {
+        tos_cpu_account();
+    }
+#endif
+    if (cycles != nullptr) {
+#if TOS_CPU_STAT_ENABLE
+        *cycles = tos_state.cpu_cycles;
+#else
+        *cycles = 0;
+#endif
+    }
 
-        if (tcb->task_wait_time != TOS_TIME_WAIT_INFINITY) {
-            if (--tcb->task_wait_time == 0) {
-                // move the task to ready list
-                util_queue_remove(&tcb->ready_pending_link);   // the task may block in a sem list
-                util_queue_insert(&tos_state.ready_task_list[tcb->task_prio], &tcb->ready_pending_link);
-                tos_state.ready_task_prio_mask |= tcb->task_prio_mask;
+    util_queue_foreach(link, &tos_state.all_task_list)
+    {
+        tos_task_tcb_t*  tcb  = get_task_by_all_link(link);
+        tos_task_stat_t* stat = &stats[count];
 
-                util_queue_remove(&tcb->waiting_link);
-                util_queue_init(&tcb->waiting_link);   // make list_node->next==list_node
-            }
+        if (count >= num) {
+            break;
+        }
+
+        stat->task             = tcb;
+        stat->task_id          = tcb->task_id;
+        stat->task_state       = tcb->task_state;
+        stat->task_prio        = tcb->task_prio;
+        stat->task_base_prio   = tcb->task_base_prio;
+        stat->task_switch_cnt  = tcb->task_switch_cnt;
+        stat->task_preempt_cnt = tcb->task_preempt_cnt;
+        stat->task_run_cycles  = tcb->task_run_cycles;
+#if TOS_TASK_CACHE_ENABLE
+        stat->task_cache_bytes = tcb->task_cache.bytes;
+        stat->task_cache_hit   = tcb->task_cache.hit_cnt;
+        stat->task_cache_miss  = tcb->task_cache.miss_cnt;
+#else
+        stat->task_cache_bytes = 0;
+        stat->task_cache_hit   = 0;
+        stat->task_cache_miss  = 0;
+#endif
+        memcpy(stat->task_name, tcb->task_name, TOS_TASK_NAME_LEN_MAX);
+        count++;
+    }
+
+    tos_leave_critical_section();
+
+    return count;
+}
+
+
+uint32_t tos_get_cpu_load(void)
+{
+#if TOS_CPU_STAT_ENABLE
+    return tos_state.cpu_load;
+#else
+    return 0;
+#endif
+}
+
+
+int32_t tos_get_task_latency(tos_task_t* task, tos_hist_t* hist)
+{
+#if TOS_LATENCY_STAT_ENABLE
+    if (task == nullptr || *task == nullptr || hist == nullptr) {
+        return -1;
+    }
+
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+    *hist = (*task)->task_latency;
+    tos_leave_critical_section();
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+uint32_t tos_hist_percentile(const tos_hist_t* hist, uint32_t permille)
+{
+    uint64_t rank = ((uint64_t)hist->total * permille + 999) / 1000;   // samples not more than the percentile
+    uint64_t seen = 0;
+
+    if (hist->total == 0) {
+        return 0;
+    }
+
+    for (uint32_t bucket = 0; bucket < TOS_HIST_BUCKETS - 1; bucket++) {
+        seen += hist->count[bucket];
+        if (seen >= rank) {
+            uint32_t upper = (bucket == 0) ? 0 : (1u << bucket) - 1;
+            return util_min2(upper, hist->max);
         }
     }
 
+    return hist->max;
+}
+
+
+void tos_time_tick(void)
+{
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+    tos_trace(TOS_TRACE_TICK, (uint16_t)(tos_state.sys_ticks + 1));
+    tos_time_advance(1);
+#if TOS_TIME_SLICE_ENABLE
+    tos_time_slice_tick();
+#endif
     tos_leave_critical_section();
 }
 
 
+void tos_task_change_prio(tos_task_tcb_t* tcb, uint8_t prio)
+{
+    tos_task_state_t state = tcb->task_state;
+
+    if (state == TOS_TASK_STATE_RUNNING || state == TOS_TASK_STATE_READY) {
+        // remove from old list, add into new list
+        tos_ready_list_remove(tcb);
+        tcb->task_prio = prio;
+        tos_ready_list_insert(tcb);
+        tcb->task_state = state;
+    } else if (tcb->task_wait_queue != nullptr) {
+        // block task, move to the new prio in its wait queue
+        tos_wait_queue_t* queue = tcb->task_wait_queue;
+        tos_wait_queue_remove(tcb);
+        tcb->task_prio = prio;
+        tos_wait_queue_insert(queue, tcb);
+    } else {
+        // sleep task, in waiting list, modify prio immediately
+        tcb->task_prio = prio;
+    }
+
+    if (tcb == tos_task_current) {
+        tos_task_prio_current = prio;
+    }
+}
+
+
+void tos_waiting_list_insert(tos_task_tcb_t* tcb, uint32_t ticks)
+{
+    tos_timeout_arm(&tcb->task_timeout, ticks);   // wakeup at next tick at least
+}
+
+
+void tos_waiting_list_remove(tos_task_tcb_t* tcb)
+{
+    tos_timeout_cancel(&tcb->task_timeout);
+}
+
+
 void tos_schedule(void)
 {
     tos_use_critical_section();
@@ -398,11 +587,11 @@ void tos_schedule(void)
     tos_enter_critical_section();
 
     if (tos_state.intr_level == 0 && tos_state.schedule_enable == true) {
-        tos_task_prio_switch_to = tos_get_highest_prio(tos_state.ready_task_prio_mask);
+        tos_task_prio_switch_to = tos_get_highest_prio();
         tos_task_switch_to = get_task_by_ready_pending_link(tos_state.ready_task_list[tos_task_prio_switch_to].next);
 
         if (tos_task_switch_to != tos_task_current) {
-            tos_task_switch_to->task_switch_cnt++;
+            tos_task_switch_prepare();
             tos_task_switch();
         }
     }
@@ -411,19 +600,66 @@ void tos_schedule(void)
 }
 
 
+/**
+ * @brief create task, the tcb is from heap or storage
+ *
+ * @param proc
+ * @param args
+ * @param attr
+ * @param storage nullptr: tcb from heap
+ * @return tos_task_t
+ */
+static tos_task_t tos_task_create_at(tos_task_proc_t proc, void* args, tos_task_attr_t* attr, tos_task_tcb_t* storage)
+{
+    tos_use_critical_section();
+
+    if (attr == nullptr || attr->task_stack == nullptr || attr->task_prio > TOS_MAX_PRIO_NUM_USED) {
+        return nullptr;
+    }
+
+    tos_enter_critical_section();
+    if (tos_state.intr_level > 0) {
+        tos_leave_critical_section();
+        return nullptr;
+    }
+
+    tos_leave_critical_section();
+
+    tos_stack_t* stack_end = &attr->task_stack[(attr->task_stack_size / sizeof(tos_stack_t))];
+
+    util_printk("create %15s: [%p, %p) %4d Bytes.\n", attr->task_name, attr->task_stack, stack_end,
+                attr->task_stack_size);
+
+    tos_stack_t*    task_stack_ptr = tos_task_stack_frame_init(proc, args, stack_end - 1);
+    tos_task_tcb_t* tcb            = tos_task_tcb_init(attr, task_stack_ptr, storage);
+
+    if (tcb == nullptr) {
+        // tos_error("try to create task(%s, id=%d) error", attr->task_name, tos_state.task_number + 1);
+        return nullptr;
+    }
+
+    if (tos_state.sys_running) {
+        tos_schedule();
+    }
+
+    return tcb;
+}
+
+
 /**
  * @brief init task TCB
  *
  * @param attr taskattr
  * @param task_stack_ptr ptr to task stack
+ * @param storage nullptr: get a free tcb from heap
  * @return tos_task_tcb_t*
  */
-static tos_task_tcb_t* tos_task_tcb_init(tos_task_attr_t* attr, tos_stack_t* task_stack_ptr)
+static tos_task_tcb_t* tos_task_tcb_init(tos_task_attr_t* attr, tos_stack_t* task_stack_ptr, tos_task_tcb_t* storage)
 {
     tos_task_tcb_t* tcb;
     tos_use_critical_section();
 
-    tcb = tos_get_free_tcb();
+    tcb = (storage != nullptr) ? storage : tos_get_free_tcb();
 
     if (tcb == nullptr) {
         return nullptr;
@@ -437,26 +673,43 @@ static tos_task_tcb_t* tos_task_tcb_init(tos_task_attr_t* attr, tos_stack_t* tas
 
     // schdule and other addr
     tcb->task_prio        = attr->task_prio;
-    tcb->task_prio_mask   = 1u << attr->task_prio;
-    tcb->task_wait_time   = attr->task_wait_time;
+    tcb->task_base_prio   = attr->task_prio;
     tcb->task_id          = tos_state.task_number;
     tcb->task_state       = TOS_TASK_STATE_READY;
     tcb->task_switch_cnt  = 0;
-    tcb->task_total_ticks = 0;
-    tcb->task_flag        = 0;
-    strncmp(tcb->task_name, attr->task_name, TOS_TASK_NAME_LEN_MAX - 1);
+    tcb->task_run_cycles  = 0;
+    tcb->task_time_slice  = (attr->task_time_slice == 0) ? TOS_TIME_SLICE_DEFAULT : attr->task_time_slice;
+    tcb->task_slice_left  = tcb->task_time_slice;
+    tcb->task_preempt_cnt = 0;
+    tcb->task_flag        = (storage != nullptr) ? TOS_TASK_FLAG_STATIC : 0;
+
+    tcb->task_wait_queue    = nullptr;
+    tcb->task_pending_mutex = nullptr;
+    tcb->task_wait_data     = nullptr;
+    tcb->task_mutex_held    = 0;
+    tcb->task_msgq_held     = 0;
+    tcb->task_notify_value  = 0;
+    tcb->task_notify_state  = TOS_NOTIFY_STATE_NONE;
+#if TOS_LATENCY_STAT_ENABLE
+    memset(&tcb->task_latency, 0, sizeof(tcb->task_latency));
+#endif
+#if TOS_TASK_CACHE_ENABLE
+    tos_task_cache_init(&tcb->task_cache);
+#endif
+    util_queue_init(&tcb->task_mutex_list);
+    tos_timeout_init(&tcb->task_timeout, tos_task_timeout_proc);
+    strncpy(tcb->task_name, attr->task_name, TOS_TASK_NAME_LEN_MAX - 1);
     tcb->task_name[TOS_TASK_NAME_LEN_MAX - 1] = 0;
 
     // modify global var, enter critical section
     tos_enter_critical_section();
 
     // inset new task tcb to ready list
-    util_queue_insert(&tos_state.ready_task_list[tcb->task_prio], &tcb->ready_pending_link);
-    util_queue_init(&tcb->waiting_link);
+    tos_ready_list_insert(tcb);
 
-    tos_state.ready_task_prio_mask |= tcb->task_prio_mask;
     tos_state.task_number++;
     util_queue_insert(&tos_state.all_task_list, &tcb->all_link);
+    tos_trace(TOS_TRACE_TASK_CREATE, tcb->task_id);
 
     tos_leave_critical_section();
 
@@ -479,19 +732,217 @@ static tos_task_tcb_t* tos_get_free_tcb(void)
 
 
 /**
- * @brief get highest prio
+ * put back a tcb of a deleted task
+ *
+ *  @param   tcb
+ *  @return  void
+ *  @see     tos_get_free_tcb
+ *  @note    not by tos_free, a task deleting itself would push its tcb into the cache inside the tcb
+ */
+static void tos_put_free_tcb(tos_task_tcb_t* tcb)
+{
+#if TOS_MEMPOOL_KERNEL_ENABLE
+    if (tos_mempool_kernel_free(tcb)) {
+        return;
+    }
+#endif
+
+    tos_heap_free(tcb);
+}
+
+
+/**
+ * @brief get highest prio of ready tasks
  *
- * @param prio_mask
  * @return uint32_t
+ * @note O(1), two clz on the prio bitmap. idle task is always ready, so the bitmap is never empty
+ */
+static uint32_t tos_get_highest_prio(void)
+{
+    return tos_prio_bitmap_highest(&tos_state.ready_prio_map);
+}
+
+
+/**
+ * @brief bookkeeping of the task to run, called before switching to tos_task_switch_to
+ *
+ * @note called in critical section
+ */
+static void tos_task_switch_prepare(void)
+{
+#if TOS_CPU_STAT_ENABLE
+    tos_cpu_account();   // charge the task switched out
+#endif
+    tos_trace(TOS_TRACE_SWITCH, tos_task_switch_to->task_id);
+    if (tos_task_current != nullptr && tos_task_current->task_state == TOS_TASK_STATE_RUNNING) {
+        tos_task_current->task_state = TOS_TASK_STATE_READY;
+    }
+    tos_task_switch_to->task_state = TOS_TASK_STATE_RUNNING;
+#if TOS_LATENCY_STAT_ENABLE
+    if (tos_task_switch_to->task_flag & TOS_TASK_FLAG_WAKEUP) {
+        tos_task_switch_to->task_flag &= ~TOS_TASK_FLAG_WAKEUP;
+        tos_hist_add(&tos_task_switch_to->task_latency, tos_cpu_cycles() - tos_task_switch_to->task_wakeup_cycles);
+    }
+#endif
+    tos_task_switch_to->task_switch_cnt++;
+    tos_task_switch_to->task_slice_left = tos_task_switch_to->task_time_slice;
+}
+
+
+#if TOS_TIME_SLICE_ENABLE
+/**
+ * @brief count down time slice of current task, move it to the list tail when expired
+ *
+ * @note called in critical section, the switch is done by tos_exit_isr
+ */
+static void tos_time_slice_tick(void)
+{
+    tos_task_tcb_t*    tcb = tos_task_current;
+    util_queue_node_t* prio_list;
+
+    // the running task has been deleted, not switched out yet
+    if (tcb == nullptr) {
+        return;
+    }
+    prio_list = &tos_state.ready_task_list[tcb->task_prio];
+
+    // a running task is the head of its ready list, otherwise it's blocked and waiting for the switch
+    if (prio_list->next != &tcb->ready_pending_link) {
+        return;
+    }
+
+    if (tcb->task_slice_left > 1) {
+        tcb->task_slice_left--;
+        return;
+    }
+
+    tcb->task_slice_left = tcb->task_time_slice;
+
+    // other tasks with same prio are ready
+    if (prio_list->prev != &tcb->ready_pending_link) {
+        util_queue_remove(&tcb->ready_pending_link);
+        util_queue_insert(prio_list, &tcb->ready_pending_link);
+        tcb->task_preempt_cnt++;
+    }
+}
+#endif
+
+
+/**
+ * @brief pass some ticks, expire timeouts of tasks and timers
+ *
+ * @param ticks
+ * @note called in critical section
+ */
+static void tos_time_advance(uint32_t ticks)
+{
+    tos_state.sys_ticks += ticks;
+#if TOS_CPU_STAT_ENABLE
+    // a task may run for long without switching, and the cycle counter could not wrap between two reads
+    tos_cpu_account();
+    if (tos_state.sys_ticks - tos_state.load_ticks >= TOS_SYS_HZ) {
+        tos_cpu_load_update();
+    }
+#endif
+    tos_timeout_advance(ticks);
+}
+
+
+#if TOS_CPU_STAT_ENABLE
+/**
+ * @brief charge the cycles since last accounting to the current task
+ *
+ * @note called in critical section
+ */
+static void tos_cpu_account(void)
+{
+    uint32_t now   = tos_cpu_cycles();
+    uint32_t delta = now - tos_state.cpu_cycles_stamp;
+
+    tos_state.cpu_cycles_stamp = now;
+    tos_state.cpu_cycles += delta;
+    if (tos_task_current != nullptr) {
+        tos_task_current->task_run_cycles += delta;
+    }
+}
+
+
+/**
+ * @brief close the load window, cpu load is the part of cycles not used by idle task
+ *
+ * @note called in critical section, once a second
+ */
+static void tos_cpu_load_update(void)
+{
+    uint64_t cycles = tos_state.cpu_cycles - tos_state.load_cycles;
+    uint64_t idle   = tos_state.idle_task->task_run_cycles - tos_state.load_idle_cycles;
+
+    if (cycles > 0) {
+        tos_state.cpu_load = (uint32_t)(1000 - idle * 1000 / cycles);
+    }
+
+    tos_state.load_ticks       = tos_state.sys_ticks;
+    tos_state.load_cycles      = tos_state.cpu_cycles;
+    tos_state.load_idle_cycles = tos_state.idle_task->task_run_cycles;
+}
+#endif
+
+
+/**
+ * @brief wakeup task when its sleep or timed wait expires
+ *
+ * @param timeout
+ * @note called in critical section
+ */
+static void tos_task_timeout_proc(tos_timeout_t* timeout)
+{
+    tos_task_tcb_t* tcb = util_containerof(tos_task_tcb_t, task_timeout, timeout);
+
+    // move the task to ready list
+    tos_wait_queue_remove(tcb);   // the task may block in a wait queue
+    tos_ready_list_insert(tcb);
+    tos_task_wakeup_stamp(tcb);
+
+    // timeout on a notify, a later notify must not make it ready again
+    if (tcb->task_notify_state == TOS_NOTIFY_STATE_WAITING) {
+        tcb->task_notify_state = TOS_NOTIFY_STATE_NONE;
+    }
+
+    // timeout on a mutex, give back the prio inherited by the owner
+    if (tcb->task_pending_mutex != nullptr) {
+        tos_mutex_prio_update(tos_mutex_owner(tcb->task_pending_mutex));
+        tcb->task_pending_mutex = nullptr;
+    }
+}
+
+
+#if TOS_TICKLESS_ENABLE
+/**
+ * @brief stop the tick until the first waiting task or timer expires, and sleep
+ *
+ * @note only when the idle task is the only ready task
  */
-static uint32_t tos_get_highest_prio(uint32_t prio_mask)
+static void tos_tickless_idle(void)
 {
-    uint32_t prio = 31;
-    while ((prio_mask & (1u << prio)) == 0) {
-        prio--;
+    util_queue_node_t* idle_list = &tos_state.ready_task_list[0];
+    uint32_t           idle_ticks;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    if (tos_get_highest_prio() == 0 && idle_list->next == idle_list->prev) {
+        idle_ticks = tos_timeout_next_ticks();
+
+        if (idle_ticks >= TOS_TICKLESS_MIN_TICKS) {
+            tos_time_advance(tos_sys_clock_sleep(idle_ticks));
+        }
     }
-    return prio;
+
+    tos_leave_critical_section();
+
+    tos_schedule();
 }
+#endif
 
 
 /**
@@ -502,5 +953,8 @@ static uint32_t tos_get_highest_prio(uint32_t prio_mask)
 static void tos_idle_task_proc(void* args)
 {
     while (true) {
+#if TOS_TICKLESS_ENABLE
+        tos_tickless_idle();
+#endif
     }
 }
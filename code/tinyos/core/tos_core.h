@@ -9,6 +9,7 @@
 #define _TOS_CORE_H_
 
 
+#include "tos_config.h"
 #include "tos_cpu.h"
 #include "tos_types.h"
 
@@ -28,6 +29,7 @@
     } while (0)
 
 typedef struct tos_task_tcb_t* tos_task_t;   // handle of task
+typedef struct tos_task_tcb_t  tos_task_storage_t;   // storage of task for tos_task_create_static, see tos_static.h
 
 typedef enum {
     TOS_TASK_INVALID = 0x00,   //
@@ -37,11 +39,34 @@ typedef enum {
     TOS_TASK_STATE_WAITING,    // sleep for some time
 } tos_task_state_t;
 
+// log2 histogram of cycles, bucket 0: 0, bucket n: [2^(n-1), 2^n), the last bucket: all above
+typedef struct {
+    uint32_t count[TOS_HIST_BUCKETS];
+    uint32_t total;   // samples
+    uint32_t max;     // max cycles
+} tos_hist_t;
+
+typedef struct {
+    tos_task_t       task;
+    uint32_t         task_id;
+    tos_task_state_t task_state;
+    uint8_t          task_prio;          // running prio
+    uint8_t          task_base_prio;     // prio set by user
+    uint32_t         task_switch_cnt;    // times switched in
+    uint32_t         task_preempt_cnt;   // switched out by time slice expired
+    uint64_t         task_run_cycles;    // cpu cycles the task has run
+    uint32_t         task_cache_bytes;   // heap bytes held by the cache of the task
+    uint32_t         task_cache_hit;     // allocs served by the cache
+    uint32_t         task_cache_miss;    // allocs of cacheable sizes went to the heap
+    char             task_name[TOS_TASK_NAME_LEN_MAX];
+} tos_task_stat_t;
+
 typedef struct {
     tos_stack_t* task_stack;        // begin address of task area (lowest addr mostly, 4B align)
     uint32_t     task_stack_size;   // n bytes
     uint8_t      task_prio;
     uint32_t     task_wait_time;
+    uint32_t     task_time_slice;   // ticks, 0: default time slice
     char*        task_name;
 } tos_task_attr_t;
 
@@ -100,12 +125,24 @@ void tos_schedule_disable(void);
  */
 tos_task_t tos_task_create(tos_task_proc_t proc, void* args, tos_task_attr_t* attr);
 
+/**
+ * @brief create new task in the storage given by caller, the heap is not used
+ *
+ * @param proc task proc
+ * @param args args of task proc
+ * @param attr task attr
+ * @param storage static or global storage, alive until the task is deleted
+ * @return handle of task, return nullptr when failed
+ */
+tos_task_t tos_task_create_static(tos_task_proc_t proc, void* args, tos_task_attr_t* attr, tos_task_storage_t* storage);
+
 /**
  * @brief delete task
  *
  * @param task
+ * @return int32_t 0 when succeed, -1 when fail, e.g. in ISR, or the task holds messages of a msgq
  */
-void tos_task_delete(tos_task_t* task);
+int32_t tos_task_delete(tos_task_t* task);
 
 /**
  * @brief
@@ -132,6 +169,14 @@ int32_t tos_get_task_prio(tos_task_t* task);
  */
 tos_task_state_t tos_get_task_state(tos_task_t* task);
 
+/**
+ * @brief set time slice of task
+ *
+ * @param task
+ * @param ticks 0: default time slice
+ */
+void tos_set_task_time_slice(tos_task_t* task, uint32_t ticks);
+
 /**
  * @brief task sleep some time
  *
@@ -153,4 +198,42 @@ void tos_task_yield(void);
  */
 bool tos_running(void);
 
+/**
+ * @brief snapshot run time stats of all tasks
+ *
+ * @param stats buffer of stats
+ * @param num max number of stats
+ * @param cycles cpu cycles since tos start, accounted at the same time with the stats, could be nullptr
+ * @return uint32_t number of stats stored
+ * @note rates are got by the difference of two snapshots, task_run_cycles is 0 if TOS_CPU_STAT_ENABLE is 0,
+ *       task_cache_* are 0 if TOS_TASK_CACHE_ENABLE is 0
+ */
+uint32_t tos_get_task_stats(tos_task_stat_t* stats, uint32_t num, uint64_t* cycles);
+
+/**
+ * @brief cpu load in last second, derived from the time of idle task
+ *
+ * @return uint32_t permille, 0 if TOS_CPU_STAT_ENABLE is 0
+ */
+uint32_t tos_get_cpu_load(void);
+
+/**
+ * @brief get the histogram of wakeup-to-run latency of task, in cycles
+ *
+ * @param task
+ * @param hist
+ * @return int32_t 0 when succeed, -1 when fail or TOS_LATENCY_STAT_ENABLE is 0
+ * @note measured from a task made ready by tick (sleep or timeout), mutex unlock or cond signal, to the switch to it
+ */
+int32_t tos_get_task_latency(tos_task_t* task, tos_hist_t* hist);
+
+/**
+ * @brief percentile of the histogram
+ *
+ * @param hist
+ * @param permille 500: p50, 990: p99, 999: p99.9
+ * @return uint32_t upper bound of the bucket which the percentile falls in, not more than the max
+ */
+uint32_t tos_hist_percentile(const tos_hist_t* hist, uint32_t permille);
+
 #endif
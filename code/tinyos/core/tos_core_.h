@@ -10,50 +10,226 @@
 
 #include "tos_config.h"
 #include "tos_core.h"
+#include "tos_taskcache_.h"
+#include "tos_timeout_.h"
 #include "util_queue.h"
 
 
+#define TOS_PRIO_GRP_NUM ((TOS_MAX_PRIO_NUM_USED >> 5) + 1)   // 32 prios per group
+
+#define TOS_TASK_FLAG_WAKEUP  (1u << 0)   // in task_flag, made ready by an event and not switched to yet
+#define TOS_TASK_FLAG_STATIC  (1u << 1)   // in task_flag, tcb is given by user, not freed when deleted
+#define TOS_TASK_FLAG_WAIT_OK (1u << 2)   // in task_flag, woken up by the object it waits, not by timeout
+
+#define TOS_NOTIFY_STATE_NONE     0   // in task_notify_state
+#define TOS_NOTIFY_STATE_RECEIVED 1   // notified, not got by wait yet
+#define TOS_NOTIFY_STATE_WAITING  2   // blocked in tos_task_notify_wait
+
+
 #define get_task_by_ready_pending_link(link)                                                                           \
-    ((tos_task_tcb_t*)((uint8_t*)(link) - (uint32_t) & ((tos_task_tcb_t*)0)->ready_pending_link))
-#define get_task_by_waiting_link(link)                                                                                 \
-    ((tos_task_tcb_t*)((uint8_t*)(link) - (uint32_t) & ((tos_task_tcb_t*)0)->waiting_link))
-#define get_task_by_all_link(link) ((tos_task_tcb_t*)((uint8_t*)(link) - (uint32_t) & ((tos_task_tcb_t*)0)->all_link))
+    ((tos_task_tcb_t*)((uint8_t*)(link) - (uintptr_t) & ((tos_task_tcb_t*)0)->ready_pending_link))
+#define get_task_by_all_link(link) ((tos_task_tcb_t*)((uint8_t*)(link) - (uintptr_t) & ((tos_task_tcb_t*)0)->all_link))
 
 typedef struct tos_task_tcb_t {
     tos_stack_t*      task_stk_ptr;         // stack ptr
     tos_stack_t*      task_stk_base;        // stack base addr (highest mostly)
     tos_stack_t*      task_stk_top;         // stack top addr (next addr after stack space)
     uint32_t          task_stk_size;        // stack size
-    util_queue_node_t ready_pending_link;   // link to ready list or pending task list
-    util_queue_node_t waiting_link;         // link to time waiting task list
+    util_queue_node_t ready_pending_link;   // link to ready list or wait queue
     util_queue_node_t all_link;             // link to all task list
-    uint32_t          task_prio_mask;       // same as (1 << prio)
-    uint32_t          task_wait_time;       // sleep or wait
+    util_queue_node_t task_mutex_list;      // mutexes owned by the task
+    tos_timeout_t     task_timeout;         // sleep or timed wait
+
+    struct tos_wait_queue_t*    task_wait_queue;      // wait queue the task is blocked in
+    struct tos_mutex_intenal_t* task_pending_mutex;   // mutex the task is blocked by
+    void*                       task_wait_data;       // e.g. slot of msgq by TOS_TASK_FLAG_WAIT_OK, mutex of cond
+    uint32_t                    task_mutex_held;      // mutexes owned, never less than the real number
+    uint32_t                    task_msgq_held;       // messages of msgqs taken in task context, not given back
+    uint32_t                    task_notify_value;    // see tos_notify.h
+    uint8_t                     task_notify_state;    // TOS_NOTIFY_STATE_*
+#if TOS_LATENCY_STAT_ENABLE
+    uint32_t   task_wakeup_cycles;   // when made ready, valid if TOS_TASK_FLAG_WAKEUP
+    tos_hist_t task_latency;         // wakeup-to-run latency
+#endif
+#if TOS_TASK_CACHE_ENABLE
+    tos_task_cache_t task_cache;   // heap blocks freed by the task, see tos_taskcache_.h
+#endif
+
     uint32_t          task_id;
     uint32_t          task_switch_cnt;
-    uint32_t          task_total_ticks;
+    uint64_t          task_run_cycles;      // cpu cycles the task has run
+    uint32_t          task_time_slice;      // ticks of a time slice
+    uint32_t          task_slice_left;      // ticks left in current time slice
+    uint32_t          task_preempt_cnt;     // switched out by time slice expired
     uint32_t          task_flag;
-    uint8_t           task_prio;
+    uint8_t           task_prio;            // running prio, may be raised by mutex waiters
+    uint8_t           task_base_prio;       // prio set by user
     tos_task_state_t  task_state;
     char              task_name[TOS_TASK_NAME_LEN_MAX];   // name info
 } tos_task_tcb_t;
 
+// two-level prio bitmap, bit n of grp_mask is set when tbl_mask[n] is not 0
+typedef struct {
+    uint32_t grp_mask;
+    uint32_t tbl_mask[TOS_PRIO_GRP_NUM];
+} tos_prio_bitmap_t;
+
+// tasks blocked on a kernel object, bucketed by prio, FIFO in the same prio
+typedef struct tos_wait_queue_t {
+    tos_prio_bitmap_t prio_map;                               // prios which have waiting tasks
+    util_queue_node_t task_list[TOS_MAX_PRIO_NUM_USED + 1];   // waiting tasks of each prio
+} tos_wait_queue_t;
+
 typedef struct {
     uint32_t          task_number;                                  // valid task number
     uint32_t          intr_level;                                   //
     uint32_t          sys_ticks;                                    //
-    uint32_t          ready_task_prio_mask;                         //
+    tos_prio_bitmap_t ready_prio_map;                               // prios which have ready tasks
     bool              schedule_enable;                              //
     bool              sys_running;                                  //
     util_queue_node_t all_task_list;                                // all tasks
-    util_queue_node_t waiting_task_list;                            // time waiting tasks
     util_queue_node_t ready_task_list[TOS_MAX_PRIO_NUM_USED + 1];   // ready tasks (like hash table)
+#if TOS_CPU_STAT_ENABLE
+    struct tos_task_tcb_t* idle_task;                               //
+    uint64_t               cpu_cycles;                              // cycles since tos start
+    uint32_t               cpu_cycles_stamp;                        // cycle counter at last accounting
+    uint32_t               cpu_load;                                // permille, in last second
+    uint32_t               load_ticks;                              // sys_ticks at start of the load window
+    uint64_t               load_cycles;                             // cpu_cycles at start of the load window
+    uint64_t               load_idle_cycles;                        // cycles of idle task at start of the window
+#endif
 } tos_run_state_t;
 
 
 extern tos_run_state_t tos_state;
 
 
+static inline void tos_prio_bitmap_init(tos_prio_bitmap_t* map)
+{
+    map->grp_mask = 0;
+    for (uint32_t grp = 0; grp < TOS_PRIO_GRP_NUM; grp++) {
+        map->tbl_mask[grp] = 0;
+    }
+}
+
+static inline void tos_prio_bitmap_set(tos_prio_bitmap_t* map, uint32_t prio)
+{
+    map->tbl_mask[prio >> 5] |= 1u << (prio & 0x1F);
+    map->grp_mask |= 1u << (prio >> 5);
+}
+
+static inline void tos_prio_bitmap_clr(tos_prio_bitmap_t* map, uint32_t prio)
+{
+    map->tbl_mask[prio >> 5] &= ~(1u << (prio & 0x1F));
+    if (map->tbl_mask[prio >> 5] == 0) {
+        map->grp_mask &= ~(1u << (prio >> 5));
+    }
+}
+
+static inline bool tos_prio_bitmap_empty(const tos_prio_bitmap_t* map)
+{
+    return map->grp_mask == 0;
+}
+
+// map should not be empty
+static inline uint32_t tos_prio_bitmap_highest(const tos_prio_bitmap_t* map)
+{
+    uint32_t grp = 31 - tos_cpu_clz(map->grp_mask);
+    return (grp << 5) + 31 - tos_cpu_clz(map->tbl_mask[grp]);
+}
+
+// add task to tail of its ready list
+static inline void tos_ready_list_insert(tos_task_tcb_t* tcb)
+{
+    util_queue_insert(&tos_state.ready_task_list[tcb->task_prio], &tcb->ready_pending_link);
+    tos_prio_bitmap_set(&tos_state.ready_prio_map, tcb->task_prio);
+    tcb->task_state = TOS_TASK_STATE_READY;
+}
+
+// remove task from ready list
+static inline void tos_ready_list_remove(tos_task_tcb_t* tcb)
+{
+    util_queue_remove(&tcb->ready_pending_link);
+    if (util_queue_empty(&tos_state.ready_task_list[tcb->task_prio])) {
+        tos_prio_bitmap_clr(&tos_state.ready_prio_map, tcb->task_prio);
+    }
+}
+
+static inline void tos_wait_queue_init(tos_wait_queue_t* queue)
+{
+    tos_prio_bitmap_init(&queue->prio_map);
+    for (uint32_t prio = 0; prio <= TOS_MAX_PRIO_NUM_USED; prio++) {
+        util_queue_init(&queue->task_list[prio]);
+    }
+}
+
+static inline bool tos_wait_queue_empty(const tos_wait_queue_t* queue)
+{
+    return tos_prio_bitmap_empty(&queue->prio_map);
+}
+
+// highest prio of waiting tasks, 0 if no task
+static inline uint32_t tos_wait_queue_highest_prio(const tos_wait_queue_t* queue)
+{
+    return tos_wait_queue_empty(queue) ? 0 : tos_prio_bitmap_highest(&queue->prio_map);
+}
+
+// first task of the highest prio, nullptr if no task
+static inline tos_task_tcb_t* tos_wait_queue_first(const tos_wait_queue_t* queue)
+{
+    if (tos_wait_queue_empty(queue)) {
+        return nullptr;
+    }
+    return get_task_by_ready_pending_link(queue->task_list[tos_prio_bitmap_highest(&queue->prio_map)].next);
+}
+
+// add task to tail of its prio in queue, the task should not be in ready list
+static inline void tos_wait_queue_insert(tos_wait_queue_t* queue, tos_task_tcb_t* tcb)
+{
+    util_queue_insert(&queue->task_list[tcb->task_prio], &tcb->ready_pending_link);
+    tos_prio_bitmap_set(&queue->prio_map, tcb->task_prio);
+    tcb->task_wait_queue = queue;
+    tcb->task_state      = TOS_TASK_STATE_PENDING;
+}
+
+// remove task from the wait queue it is blocked in, if any
+static inline void tos_wait_queue_remove(tos_task_tcb_t* tcb)
+{
+    tos_wait_queue_t* queue = tcb->task_wait_queue;
+
+    if (queue == nullptr) {
+        return;
+    }
+    util_queue_remove(&tcb->ready_pending_link);
+    util_queue_init(&tcb->ready_pending_link);
+    if (util_queue_empty(&queue->task_list[tcb->task_prio])) {
+        tos_prio_bitmap_clr(&queue->prio_map, tcb->task_prio);
+    }
+    tcb->task_wait_queue = nullptr;
+}
+
+// count cycles into its log2 bucket
+static inline void tos_hist_add(tos_hist_t* hist, uint32_t cycles)
+{
+    uint32_t bucket = (cycles == 0) ? 0 : 32 - tos_cpu_clz(cycles);
+
+    hist->count[(bucket < TOS_HIST_BUCKETS) ? bucket : TOS_HIST_BUCKETS - 1]++;
+    hist->total++;
+    if (cycles > hist->max) {
+        hist->max = cycles;
+    }
+}
+
+// task is made ready by an event, its wakeup-to-run latency starts
+static inline void tos_task_wakeup_stamp(tos_task_tcb_t* tcb)
+{
+#if TOS_LATENCY_STAT_ENABLE
+    tcb->task_wakeup_cycles = tos_cpu_cycles();
+    tcb->task_flag |= TOS_TASK_FLAG_WAKEUP;
+#endif
+}
+
+
 /**
  * @brief
  *
@@ -67,6 +243,32 @@ tos_task_tcb_t* tos_get_current_task(void);
  */
 void tos_time_tick(void);
 
+/**
+ * @brief change running prio of task, keep it in the right ready list
+ *
+ * @param tcb
+ * @param prio
+ * @note called in critical section, no schedule
+ */
+void tos_task_change_prio(tos_task_tcb_t* tcb, uint8_t prio);
+
+/**
+ * @brief arm timeout of task, wakeup after ticks
+ *
+ * @param tcb
+ * @param ticks
+ * @note called in critical section, O(1) on the timing wheel
+ */
+void tos_waiting_list_insert(tos_task_tcb_t* tcb, uint32_t ticks);
+
+/**
+ * @brief cancel timeout of task, nothing to do if it's not armed
+ *
+ * @param tcb
+ * @note called in critical section, O(1)
+ */
+void tos_waiting_list_remove(tos_task_tcb_t* tcb);
+
 /**
  * @brief tos_schedule
  *
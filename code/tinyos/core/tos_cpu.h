@@ -17,6 +17,16 @@
  */
 void tos_sys_clock_init(void);
 
+/**
+ * @brief stop the periodic tick and sleep the cpu, wakeup after ticks or by other irq
+ *
+ * @param ticks max ticks to sleep, port may sleep less
+ * @return uint32_t ticks elapsed during sleep
+ * @note called with irq disabled, the periodic tick is restored before return, and the tick
+ *       expired during sleep is cleared (it's counted in the return value)
+ */
+uint32_t tos_sys_clock_sleep(uint32_t ticks);
+
 /**
  * @brief task stack frame init
  *
@@ -72,6 +82,52 @@ void tos_irq_enable(void);
  */
 void tos_irq_restore(uint32_t primask);
 
+/**
+ * @brief count leading zeros, x should not be 0
+ *
+ * @note use CLZ instruction if the compiler could emit it, or implement by port
+ */
+#if defined(__CC_ARM)
+#define tos_cpu_clz(x) __clz(x)
+#elif defined(__GNUC__)
+#define tos_cpu_clz(x) ((uint32_t)__builtin_clz(x))
+#else
+uint32_t tos_cpu_clz(uint32_t x);
+#endif
+
+/**
+ * @brief atomic compare and swap, store desired to addr if it equals to expected
+ *
+ * @param addr
+ * @param expected
+ * @param desired
+ * @return true if stored
+ * @note lock-free if the cpu supports (LDREX/STREX, atomic instructions), or implement by masking irq
+ */
+bool tos_cpu_cas(volatile uintptr_t* addr, uintptr_t expected, uintptr_t desired);
+
+/**
+ * @brief free running cycle counter, used by cpu time accounting
+ *
+ * @return uint32_t
+ * @note DWT CYCCNT on CM3, monotonic clock in us on host, sys ticks on RH850. only the difference of two reads
+ *       is used, the kernel reads it at every switch and tick, so it may wrap but not twice between two reads
+ */
+uint32_t tos_cpu_cycles(void);
+
 #define tos_systick_isr SysTick_Handler
 
+void tos_systick_isr(void);
+
+#if defined(TOS_PORT_POSIX)
+/**
+ * @brief host only, attach a signal as an irq, like enabling an irq in NVIC
+ *
+ * @param signo
+ * @param isr called with irq enabled, or replayed when irq is enabled again
+ * @return int 0: ok, -1: no free irq
+ */
+int tos_cpu_irq_attach(int signo, void (*isr)(void));
+#endif
+
 #endif
@@ -0,0 +1,383 @@
+/**
+ * @file tos_event.c
+ * @brief event flag group
+ * @note the condition of a waiter is kept on its stack, set checks all waiters in one pass
+ */
+
+#include "tos_event.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_event_.h"
+#include "tos_mem.h"
+#include "tos_trace_.h"
+#include "util_queue.h"
+
+#define EVENT_VALID_FLAG   0x5A5A5A5A
+#define EVENT_INVALID_FLAG 0xFFFFFFFF
+
+
+// condition of a waiting task, pointed by its task_wait_data
+typedef struct {
+    uint32_t mask;
+    uint32_t options;
+    uint32_t flags;   // flags when satisfied
+} tos_event_waiter_t;
+
+
+static void tos_event_setup(tos_event_intenal_t* event_intenal, bool is_static);
+static int  tos_event_get_intenal(tos_event_t* event, tos_event_intenal_t** event_intenal);
+static bool tos_event_satisfied(uint32_t flags, uint32_t mask, uint32_t options);
+static bool tos_event_wakeup(tos_event_intenal_t* event_intenal);
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param attr
+ * @return int
+ */
+int tos_event_init(tos_event_t* event, const tos_event_attr_t* attr)
+{
+    if (event == nullptr) {
+        return TOS_ERR_EVENT_NULLPTR;
+    }
+
+    // get a free event
+    tos_event_intenal_t* event_intenal = (tos_event_intenal_t*)tos_malloc(sizeof(tos_event_intenal_t));
+    if (event_intenal == nullptr) {
+        *event = nullptr;
+        return TOS_ERR_EVENT_NOFREE;
+    }
+
+    *event = event_intenal;
+    tos_event_setup(event_intenal, false);
+
+    return 0;
+}
+
+
+/**
+ * @brief init event in the storage given by caller, the heap is not used
+ *
+ * @param event
+ * @param attr
+ * @param storage static or global storage, alive until the event is destroyed
+ * @return int
+ */
+int tos_event_init_static(tos_event_t* event, const tos_event_attr_t* attr, tos_event_storage_t* storage)
+{
+    if (event == nullptr || storage == nullptr) {
+        return TOS_ERR_EVENT_NULLPTR;
+    }
+
+    *event = storage;
+    tos_event_setup(storage, true);
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param flags
+ * @return int
+ * @note ISR safe, schedule is deferred to tos_exit_isr
+ */
+int tos_event_set(tos_event_t* event, uint32_t flags)
+{
+    tos_event_intenal_t* event_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_event_get_intenal(event, &event_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    event_intenal->flags |= flags;
+    tos_trace(TOS_TRACE_EVENT_SET, tos_trace_obj(event_intenal));
+
+    bool woken = tos_event_wakeup(event_intenal);
+
+    tos_leave_critical_section();
+
+    if (woken) {
+        tos_schedule();
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param flags
+ * @return int
+ */
+int tos_event_clear(tos_event_t* event, uint32_t flags)
+{
+    tos_event_intenal_t* event_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_event_get_intenal(event, &event_intenal);
+    if (ret == 0) {
+        event_intenal->flags &= ~flags;
+    }
+
+    tos_leave_critical_section();
+
+    return ret;
+}
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param flags
+ * @return int
+ */
+int tos_event_get(tos_event_t* event, uint32_t* flags)
+{
+    tos_event_intenal_t* event_intenal;
+    tos_use_critical_section();
+
+    if (flags == nullptr) {
+        return TOS_ERR_EVENT_NULLPTR;
+    }
+
+    tos_enter_critical_section();
+
+    int ret = tos_event_get_intenal(event, &event_intenal);
+    if (ret == 0) {
+        *flags = event_intenal->flags;
+    }
+
+    tos_leave_critical_section();
+
+    return ret;
+}
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param mask
+ * @param options
+ * @param flags
+ * @param try_nms
+ * @return int
+ */
+int tos_event_wait(tos_event_t* event, uint32_t mask, uint32_t options, uint32_t* flags, uint32_t try_nms)
+{
+    tos_event_intenal_t* event_intenal;
+    tos_event_waiter_t   waiter = {mask, options, 0};
+    tos_use_critical_section();
+
+    if (mask == 0) {
+        return TOS_ERR_EVENT_PARAM;
+    }
+
+    tos_enter_critical_section();
+
+    int ret = tos_event_get_intenal(event, &event_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    // 1 satisfied already
+    if (tos_event_satisfied(event_intenal->flags, mask, options)) {
+        waiter.flags = event_intenal->flags;
+        if (options & TOS_EVENT_CLEAR) {
+            event_intenal->flags &= ~mask;
+        }
+        tos_leave_critical_section();
+
+        if (flags != nullptr) {
+            *flags = waiter.flags;
+        }
+        return 0;
+    }
+
+    // 2.1 immediately, ISR can not wait
+    if (try_nms == TOS_EVENT_WAIT_IMMEDIATE || tos_state.intr_level > 0) {
+        tos_leave_critical_section();
+        return TOS_ERR_EVENT_TIMEOUT;
+    }
+
+    // 2.2 wait flags
+    // add current task to pending list
+    tos_task_tcb_t* current_task = tos_get_current_task();
+    tos_trace(TOS_TRACE_EVENT_PEND, tos_trace_obj(event_intenal));
+    current_task->task_flag &= ~TOS_TASK_FLAG_WAIT_OK;
+    current_task->task_wait_data = &waiter;
+    tos_ready_list_remove(current_task);
+    tos_wait_queue_insert(&event_intenal->pending_list, current_task);
+
+    // add current task into waiting list
+    if (try_nms != TOS_EVENT_WAIT_INFINITE) {
+        tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
+    }
+    tos_leave_critical_section();
+
+    tos_schedule();
+
+    // satisfied by set, or timeout
+    current_task->task_wait_data = nullptr;
+    if ((current_task->task_flag & TOS_TASK_FLAG_WAIT_OK) == 0) {
+        return TOS_ERR_EVENT_TIMEOUT;
+    }
+
+    if (flags != nullptr) {
+        *flags = waiter.flags;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @return int
+ */
+int tos_event_destroy(tos_event_t* event)
+{
+    tos_event_intenal_t* event_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_event_get_intenal(event, &event_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    if (!tos_wait_queue_empty(&event_intenal->pending_list)) {
+        tos_leave_critical_section();
+        return TOS_ERR_EVENT_BLOCKING;
+    }
+
+    event_intenal->valid_flag = EVENT_INVALID_FLAG;
+
+    tos_leave_critical_section();
+
+    if (!event_intenal->is_static) {
+        tos_free(event_intenal);
+    }
+
+    *event = nullptr;
+
+    return 0;
+}
+
+
+/**
+ * @brief init event in its storage, no flag is set
+ *
+ * @param event_intenal
+ * @param is_static
+ */
+static void tos_event_setup(tos_event_intenal_t* event_intenal, bool is_static)
+{
+    event_intenal->flags     = 0;
+    event_intenal->is_static = is_static;
+    tos_wait_queue_init(&(event_intenal->pending_list));
+    event_intenal->valid_flag = EVENT_VALID_FLAG;
+}
+
+
+/**
+ * @brief check the event handle, the one by TOS_EVENT_INITIALIZER is setup at its first use
+ *
+ * @param event
+ * @param event_intenal
+ * @return int
+ * @note called in critical section
+ */
+static int tos_event_get_intenal(tos_event_t* event, tos_event_intenal_t** event_intenal)
+{
+    if (event == nullptr || *event == nullptr) {
+        return TOS_ERR_EVENT_NULLPTR;
+    }
+
+    if ((*event)->valid_flag == EVENT_INITIALIZER_FLAG) {
+        tos_event_setup(*event, true);
+    }
+
+    if ((*event)->valid_flag != EVENT_VALID_FLAG) {
+        return TOS_ERR_EVENT_INVALID;
+    }
+
+    *event_intenal = *event;
+    return 0;
+}
+
+
+static bool tos_event_satisfied(uint32_t flags, uint32_t mask, uint32_t options)
+{
+    if (options & TOS_EVENT_WAIT_ALL) {
+        return (flags & mask) == mask;
+    }
+    return (flags & mask) != 0;
+}
+
+
+/**
+ * @brief wakeup all waiters satisfied by current flags, highest prio first, FIFO in the same prio
+ *
+ * @param event_intenal
+ * @return true if any task is woken up
+ * @note called in critical section
+ */
+static bool tos_event_wakeup(tos_event_intenal_t* event_intenal)
+{
+    bool              woken = false;
+    tos_prio_bitmap_t map   = event_intenal->pending_list.prio_map;   // a copy, waiters are removed below
+
+    // only the prios which have waiters
+    while (!tos_prio_bitmap_empty(&map) && event_intenal->flags != 0) {
+        uint32_t           prio = tos_prio_bitmap_highest(&map);
+        util_queue_node_t* list = &event_intenal->pending_list.task_list[prio];
+        util_queue_node_t* node = list->next;
+
+        tos_prio_bitmap_clr(&map, prio);
+
+        while (node != list) {
+            tos_task_tcb_t*     tcb    = get_task_by_ready_pending_link(node);
+            tos_event_waiter_t* waiter = (tos_event_waiter_t*)tcb->task_wait_data;
+
+            node = node->next;   // tcb may be removed below
+            if (!tos_event_satisfied(event_intenal->flags, waiter->mask, waiter->options)) {
+                continue;
+            }
+
+            waiter->flags = event_intenal->flags;
+            if (waiter->options & TOS_EVENT_CLEAR) {
+                event_intenal->flags &= ~waiter->mask;
+            }
+
+            tos_wait_queue_remove(tcb);
+            tos_waiting_list_remove(tcb);
+            tcb->task_flag |= TOS_TASK_FLAG_WAIT_OK;
+            tos_ready_list_insert(tcb);
+            tos_task_wakeup_stamp(tcb);
+            woken = true;
+        }
+    }
+
+    return woken;
+}
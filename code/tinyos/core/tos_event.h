@@ -0,0 +1,108 @@
+/**
+ * @file tos_event.h
+ * @brief event flag group, 32 flags
+ * @note set and clear are ISR safe, set wakes up all waiters it satisfies
+ */
+
+#ifndef _TOS_EVENT_H_
+#define _TOS_EVENT_H_
+
+
+#include "tos_core.h"
+#include "tos_types.h"
+
+
+#define TOS_ERR_EVENT_NULLPTR    -1
+#define TOS_ERR_EVENT_NOFREE     -2
+#define TOS_ERR_EVENT_TIMEOUT    -3
+#define TOS_ERR_EVENT_PARAM      -4   // mask is 0
+#define TOS_ERR_EVENT_BLOCKING   -6   // blocking when destroy
+#define TOS_ERR_EVENT_INVALID    -7
+
+#define TOS_EVENT_WAIT_INFINITE  0xFFFFFFFFu
+#define TOS_EVENT_WAIT_IMMEDIATE 0
+
+#define TOS_EVENT_WAIT_ANY       0u          // options of wait, any flag of the mask is set
+#define TOS_EVENT_WAIT_ALL       (1u << 0)   // all flags of the mask are set
+#define TOS_EVENT_CLEAR          (1u << 1)   // clear the flags of the mask when satisfied
+
+
+typedef struct tos_event_intenal_t* tos_event_t;
+typedef struct tos_event_intenal_t  tos_event_storage_t;   // storage for tos_event_init_static, see tos_static.h
+
+typedef struct {
+    uint8_t resv;
+} tos_event_attr_t;
+
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param attr
+ * @return int
+ */
+int tos_event_init(tos_event_t* event, const tos_event_attr_t* attr);
+
+/**
+ * @brief init event in the storage given by caller, the heap is not used
+ *
+ * @param event
+ * @param attr
+ * @param storage
+ * @return int
+ */
+int tos_event_init_static(tos_event_t* event, const tos_event_attr_t* attr, tos_event_storage_t* storage);
+
+/**
+ * @brief set flags, wakeup all waiters satisfied, highest prio first
+ *
+ * @param event
+ * @param flags
+ * @return int
+ * @note ISR safe. a waiter with TOS_EVENT_CLEAR takes its flags away from the waiters after it
+ */
+int tos_event_set(tos_event_t* event, uint32_t flags);
+
+/**
+ * @brief
+ *
+ * @param event
+ * @param flags
+ * @return int
+ * @note ISR safe
+ */
+int tos_event_clear(tos_event_t* event, uint32_t flags);
+
+/**
+ * @brief current flags
+ *
+ * @param event
+ * @param flags
+ * @return int
+ * @note ISR safe
+ */
+int tos_event_get(tos_event_t* event, uint32_t* flags);
+
+/**
+ * @brief wait for any or all flags of the mask
+ *
+ * @param event
+ * @param mask
+ * @param options TOS_EVENT_WAIT_ANY or TOS_EVENT_WAIT_ALL, | TOS_EVENT_CLEAR
+ * @param flags nullptr or flags when satisfied, before cleared
+ * @param try_nms TOS_EVENT_WAIT_IMMEDIATE in ISR
+ * @return int
+ */
+int tos_event_wait(tos_event_t* event, uint32_t mask, uint32_t options, uint32_t* flags, uint32_t try_nms);
+
+/**
+ * @brief
+ *
+ * @param event
+ * @return int
+ */
+int tos_event_destroy(tos_event_t* event);
+
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @file tos_event_.h
+ * @brief event flag group
+ * @note private, not for user
+ */
+
+#ifndef _TOS_EVENT__H_
+#define _TOS_EVENT__H_
+
+
+#include "tos_core_.h"
+#include "tos_event.h"
+
+
+#define EVENT_INITIALIZER_FLAG 0xA5A5A5A5u   // valid_flag by TOS_EVENT_INITIALIZER, setup at the first use
+
+
+typedef struct tos_event_intenal_t {
+    uint32_t         valid_flag;
+    uint32_t         flags;
+    tos_wait_queue_t pending_list;   // tasks waiting for flags
+    bool             is_static;      // storage is given by user, not freed by destroy
+} tos_event_intenal_t;
+
+
+#endif
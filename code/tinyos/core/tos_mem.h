@@ -2,9 +2,12 @@
 #define _TOS_MEM_H_
 
 #include "tos_core.h"
+#include "tos_mempool_.h"
+#include "tos_taskcache_.h"
 #include "util_heap.h"
 
-static inline void* tos_malloc(tos_size_t size)
+// the heap itself, shared by all tasks and ISRs
+static inline void* tos_heap_malloc(tos_size_t size)
 {
     tos_use_critical_section();
     tos_enter_critical_section();
@@ -13,7 +16,7 @@ static inline void* tos_malloc(tos_size_t size)
     return p;
 }
 
-static inline void tos_free(void* ptr)
+static inline void tos_heap_free(void* ptr)
 {
     tos_use_critical_section();
     tos_enter_critical_section();
@@ -21,4 +24,39 @@ static inline void tos_free(void* ptr)
     tos_leave_critical_section();
 }
 
+static inline void* tos_malloc(tos_size_t size)
+{
+#if TOS_MEMPOOL_KERNEL_ENABLE
+    void* blk = tos_mempool_kernel_alloc(size);
+    if (blk != nullptr) {
+        return blk;
+    }
+#endif
+
+#if TOS_TASK_CACHE_ENABLE
+    if (size != 0 && size <= TOS_TASK_CACHE_SIZE_MAX) {
+        return tos_task_cache_alloc(size);
+    }
+#endif
+
+    return tos_heap_malloc(size);
+}
+
+static inline void tos_free(void* ptr)
+{
+#if TOS_MEMPOOL_KERNEL_ENABLE
+    if (tos_mempool_kernel_free(ptr)) {
+        return;
+    }
+#endif
+
+#if TOS_TASK_CACHE_ENABLE
+    if (tos_task_cache_free(ptr)) {
+        return;
+    }
+#endif
+
+    tos_heap_free(ptr);
+}
+
 #endif
@@ -0,0 +1,410 @@
+/**
+ * @file tos_mempool.c
+ * @brief fixed-block memory pool
+ * @note free blocks are a stack linked by the index of the next free block, stored in the block itself. the head is
+ *       swapped by CAS together with a tag bumped on every change, so a head popped and pushed back by an ISR
+ *       between the read and the CAS of a task is not taken as unchanged (ABA)
+ */
+
+#include "tos_mempool.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_cpu.h"
+#include "tos_mem.h"
+#include "tos_mempool_.h"
+#include "util_misc.h"
+#include "util_queue.h"
+
+#define MEMPOOL_VALID_FLAG   0x5A5A5A5A
+#define MEMPOOL_INVALID_FLAG 0xFFFFFFFF
+
+#define MEMPOOL_IDX_MASK     0xFFFFu
+#define MEMPOOL_IDX_NIL      0xFFFFu   // no free block
+#define MEMPOOL_TAG_UNIT     0x10000u
+
+
+#if TOS_MEMPOOL_KERNEL_ENABLE
+typedef struct {
+    uint32_t blk_size;
+    uint32_t blk_num;
+} tos_mempool_class_t;
+#endif
+
+
+static int  tos_mempool_check_attr(const tos_mempool_attr_t* attr);
+static void tos_mempool_setup(tos_mempool_intenal_t* pool_intenal, const tos_mempool_attr_t* attr, bool is_static);
+static void tos_mempool_atomic_add(volatile uintptr_t* value, uintptr_t delta);
+static void tos_mempool_push(tos_mempool_intenal_t* pool_intenal, uint32_t idx);
+static void* tos_mempool_pop(tos_mempool_intenal_t* pool_intenal);
+
+
+static util_queue_node_t tos_mempool_all_list = {&tos_mempool_all_list, &tos_mempool_all_list};   // all pools
+#if TOS_MEMPOOL_KERNEL_ENABLE
+static const tos_mempool_class_t tos_mempool_kernel_classes[] = {TOS_MEMPOOL_KERNEL_CLASSES};
+static tos_mempool_storage_t     tos_mempool_kernel_pools[util_arraylen(tos_mempool_kernel_classes)];
+static bool                      tos_mempool_kernel_inited = false;
+#endif
+
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @param attr
+ * @return int
+ */
+int tos_mempool_init(tos_mempool_t* pool, const tos_mempool_attr_t* attr)
+{
+    int err;
+
+    if (pool == nullptr) {
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+    if ((err = tos_mempool_check_attr(attr)) != 0) {
+        return err;
+    }
+
+    // get a free pool
+    tos_mempool_intenal_t* pool_intenal = (tos_mempool_intenal_t*)tos_malloc(sizeof(tos_mempool_intenal_t));
+    if (pool_intenal == nullptr) {
+        *pool = nullptr;
+        return TOS_ERR_MEMPOOL_NOFREE;
+    }
+
+    *pool = pool_intenal;
+    tos_mempool_setup(pool_intenal, attr, false);
+
+    return 0;
+}
+
+
+/**
+ * @brief init pool in the storage given by caller, the heap is not used
+ *
+ * @param pool
+ * @param attr
+ * @param storage static or global storage, alive until the pool is destroyed
+ * @return int
+ */
+int tos_mempool_init_static(tos_mempool_t* pool, const tos_mempool_attr_t* attr, tos_mempool_storage_t* storage)
+{
+    int err;
+
+    if (pool == nullptr || storage == nullptr) {
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+    if ((err = tos_mempool_check_attr(attr)) != 0) {
+        return err;
+    }
+
+    *pool = storage;
+    tos_mempool_setup(storage, attr, true);
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @return void*
+ */
+void* tos_mempool_alloc(tos_mempool_t* pool)
+{
+    if (pool == nullptr || *pool == nullptr || (*pool)->valid_flag != MEMPOOL_VALID_FLAG) {
+        return nullptr;
+    }
+
+    return tos_mempool_pop(*pool);
+}
+
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @param blk
+ * @return int
+ */
+int tos_mempool_free(tos_mempool_t* pool, void* blk)
+{
+    if (pool == nullptr || *pool == nullptr || blk == nullptr) {
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+
+    tos_mempool_intenal_t* pool_intenal = *pool;
+    uintptr_t              offset       = (uintptr_t)((uint8_t*)blk - pool_intenal->buffer);
+
+    if (pool_intenal->valid_flag != MEMPOOL_VALID_FLAG) {
+        return TOS_ERR_MEMPOOL_INVALID;
+    }
+
+    // not a block of this pool
+    if ((uint8_t*)blk < pool_intenal->buffer || offset >= (uintptr_t)pool_intenal->blk_size * pool_intenal->blk_num ||
+        offset % pool_intenal->blk_size != 0) {
+        return TOS_ERR_MEMPOOL_PARAM;
+    }
+
+    tos_mempool_push(pool_intenal, (uint32_t)(offset / pool_intenal->blk_size));
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @return int
+ */
+int tos_mempool_destroy(tos_mempool_t* pool)
+{
+    if (pool == nullptr) {
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+
+    tos_use_critical_section();
+    tos_enter_critical_section();
+
+    if (*pool == nullptr) {
+        tos_leave_critical_section();
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+
+    tos_mempool_intenal_t* pool_intenal = *pool;
+
+    if (pool_intenal->valid_flag != MEMPOOL_VALID_FLAG || pool_intenal->kernel) {
+        tos_leave_critical_section();
+        return TOS_ERR_MEMPOOL_INVALID;
+    }
+
+    if (pool_intenal->used != 0) {
+        tos_leave_critical_section();
+        return TOS_ERR_MEMPOOL_INUSE;
+    }
+
+    pool_intenal->valid_flag = MEMPOOL_INVALID_FLAG;
+    util_queue_remove(&pool_intenal->all_link);
+
+    tos_leave_critical_section();
+
+    if (!pool_intenal->is_static) {
+        tos_free(pool_intenal);
+    }
+
+    *pool = nullptr;
+
+    return 0;
+}
+
+
+uint32_t tos_get_mempool_stats(tos_mempool_stat_t* stats, uint32_t num)
+{
+    uint32_t count = 0;
+    tos_use_critical_section();
+
+    if (stats == nullptr) {
+        return 0;
+    }
+
+    tos_enter_critical_section();
+    util_queue_foreach(node, &tos_mempool_all_list)
+    {
+        tos_mempool_intenal_t* pool_intenal = util_containerof(tos_mempool_intenal_t, all_link, node);
+
+        if (count >= num) {
+            break;
+        }
+        stats[count].pool     = pool_intenal;
+        stats[count].blk_size = pool_intenal->blk_size;
+        stats[count].blk_num  = pool_intenal->blk_num;
+        stats[count].used     = (uint32_t)pool_intenal->used;
+        stats[count].used_max = (uint32_t)pool_intenal->used_max;
+        stats[count].fail_cnt = (uint32_t)pool_intenal->fail_cnt;
+        stats[count].kernel   = pool_intenal->kernel;
+        count++;
+    }
+    tos_leave_critical_section();
+
+    return count;
+}
+
+
+#if TOS_MEMPOOL_KERNEL_ENABLE
+bool tos_mempool_kernel_init(void)
+{
+    tos_mempool_attr_t attr;
+
+    if (tos_mempool_kernel_inited) {
+        return true;
+    }
+
+    for (uint32_t i = 0; i < util_arraylen(tos_mempool_kernel_classes); i++) {
+        const uintptr_t align = sizeof(uintptr_t) - 1;
+        uintptr_t       buffer;
+
+        attr.pool_blk_size = tos_mempool_kernel_classes[i].blk_size;
+        attr.pool_blk_num  = tos_mempool_kernel_classes[i].blk_num;
+
+        // before any task runs, aligned by hand, the heap may align to 4 only
+        buffer           = (uintptr_t)util_malloc(attr.pool_blk_size * attr.pool_blk_num + align);
+        attr.pool_buffer = (buffer == 0) ? nullptr : (void*)((buffer + align) & ~align);
+        if (tos_mempool_check_attr(&attr) != 0) {
+            return false;
+        }
+        tos_mempool_setup(&tos_mempool_kernel_pools[i], &attr, true);
+        tos_mempool_kernel_pools[i].kernel = true;
+    }
+
+    tos_mempool_kernel_inited = true;
+    return true;
+}
+
+
+void* tos_mempool_kernel_alloc(tos_size_t size)
+{
+    void* blk;
+
+    if (!tos_mempool_kernel_inited) {
+        return nullptr;
+    }
+
+    // the smallest class fits, then larger ones
+    for (uint32_t i = 0; i < util_arraylen(tos_mempool_kernel_classes); i++) {
+        if (size <= tos_mempool_kernel_pools[i].blk_size && (blk = tos_mempool_pop(&tos_mempool_kernel_pools[i]))) {
+            return blk;
+        }
+    }
+
+    return nullptr;
+}
+
+
+bool tos_mempool_kernel_free(void* ptr)
+{
+    if (!tos_mempool_kernel_inited) {
+        return false;
+    }
+
+    // by address range first, most of blocks freed by tos_free are from the heap
+    for (uint32_t i = 0; i < util_arraylen(tos_mempool_kernel_classes); i++) {
+        tos_mempool_t pool   = &tos_mempool_kernel_pools[i];
+        uintptr_t     offset = (uintptr_t)((uint8_t*)ptr - pool->buffer);
+
+        if (offset < (uintptr_t)pool->blk_size * pool->blk_num) {
+            return tos_mempool_free(&pool, ptr) == 0;
+        }
+    }
+
+    return false;
+}
+#endif
+
+
+static int tos_mempool_check_attr(const tos_mempool_attr_t* attr)
+{
+    if (attr == nullptr || attr->pool_buffer == nullptr) {
+        return TOS_ERR_MEMPOOL_NULLPTR;
+    }
+
+    // the link of free block is kept in the block
+    if (attr->pool_blk_size < sizeof(uintptr_t) || attr->pool_blk_size % sizeof(uintptr_t) != 0 ||
+        (uintptr_t)attr->pool_buffer % sizeof(uintptr_t) != 0) {
+        return TOS_ERR_MEMPOOL_PARAM;
+    }
+
+    if (attr->pool_blk_num == 0 || attr->pool_blk_num > TOS_MEMPOOL_BLK_NUM_MAX) {
+        return TOS_ERR_MEMPOOL_PARAM;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief link all blocks in order
+ *
+ * @param pool_intenal
+ * @param attr checked
+ * @param is_static
+ */
+static void tos_mempool_setup(tos_mempool_intenal_t* pool_intenal, const tos_mempool_attr_t* attr, bool is_static)
+{
+    tos_use_critical_section();
+
+    pool_intenal->buffer   = attr->pool_buffer;
+    pool_intenal->blk_size = attr->pool_blk_size;
+    pool_intenal->blk_num  = attr->pool_blk_num;
+
+    for (uint32_t i = 0; i < pool_intenal->blk_num; i++) {
+        *(uintptr_t*)(pool_intenal->buffer + i * pool_intenal->blk_size) =
+            (i + 1 < pool_intenal->blk_num) ? i + 1 : MEMPOOL_IDX_NIL;
+    }
+
+    pool_intenal->free_head  = 0;
+    pool_intenal->used       = 0;
+    pool_intenal->used_max   = 0;
+    pool_intenal->fail_cnt   = 0;
+    pool_intenal->is_static  = is_static;
+    pool_intenal->kernel     = false;
+    pool_intenal->valid_flag = MEMPOOL_VALID_FLAG;
+
+    tos_enter_critical_section();
+    util_queue_insert(&tos_mempool_all_list, &pool_intenal->all_link);
+    tos_leave_critical_section();
+}
+
+
+static void tos_mempool_atomic_add(volatile uintptr_t* value, uintptr_t delta)
+{
+    uintptr_t old;
+
+    do {
+        old = *value;
+    } while (!tos_cpu_cas(value, old, old + delta));
+}
+
+
+static void tos_mempool_push(tos_mempool_intenal_t* pool_intenal, uint32_t idx)
+{
+    uintptr_t* blk = (uintptr_t*)(pool_intenal->buffer + idx * pool_intenal->blk_size);
+    uintptr_t  head;
+
+    // before the block is visible, used never exceeds the blocks really held
+    tos_mempool_atomic_add(&pool_intenal->used, (uintptr_t)-1);
+
+    do {
+        head = pool_intenal->free_head;
+        *blk = head & MEMPOOL_IDX_MASK;
+    } while (!tos_cpu_cas(&pool_intenal->free_head, head, ((head & ~MEMPOOL_IDX_MASK) + MEMPOOL_TAG_UNIT) | idx));
+}
+
+
+static void* tos_mempool_pop(tos_mempool_intenal_t* pool_intenal)
+{
+    uintptr_t head, idx, used;
+    uint8_t*  blk;
+
+    do {
+        head = pool_intenal->free_head;
+        idx  = head & MEMPOOL_IDX_MASK;
+        if (idx == MEMPOOL_IDX_NIL) {
+            tos_mempool_atomic_add(&pool_intenal->fail_cnt, 1);
+            return nullptr;
+        }
+        // the link may be overwritten by the owner if the block is popped meanwhile, then the tag differs
+        blk = pool_intenal->buffer + idx * pool_intenal->blk_size;
+    } while (!tos_cpu_cas(&pool_intenal->free_head, head,
+                          ((head & ~MEMPOOL_IDX_MASK) + MEMPOOL_TAG_UNIT) | (*(volatile uintptr_t*)blk & MEMPOOL_IDX_MASK)));
+
+    tos_mempool_atomic_add(&pool_intenal->used, 1);
+
+    // high-water
+    do {
+        used = pool_intenal->used;
+        idx  = pool_intenal->used_max;
+    } while (used > idx && !tos_cpu_cas(&pool_intenal->used_max, idx, used));
+
+    return blk;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file tos_mempool.h
+ * @brief fixed-block memory pool
+ * @note storage given by caller is carved into blocks of the same size, alloc and free are lock free and ISR safe
+ */
+
+#ifndef _TOS_MEMPOOL_H_
+#define _TOS_MEMPOOL_H_
+
+
+#include "tos_core.h"
+#include "tos_types.h"
+
+
+#define TOS_ERR_MEMPOOL_NULLPTR -1
+#define TOS_ERR_MEMPOOL_NOFREE  -2
+#define TOS_ERR_MEMPOOL_PARAM   -4   // size or alignment of blocks, or block not of the pool
+#define TOS_ERR_MEMPOOL_INUSE   -6   // blocks not freed when destroy
+#define TOS_ERR_MEMPOOL_INVALID -7
+
+#define TOS_MEMPOOL_BLK_NUM_MAX 0xFFFFu
+
+
+typedef struct tos_mempool_intenal_t* tos_mempool_t;
+typedef struct tos_mempool_intenal_t  tos_mempool_storage_t;   // storage for tos_mempool_init_static, see tos_static.h
+
+typedef struct {
+    void*    pool_buffer;     // pool_blk_size * pool_blk_num bytes, aligned to pointer
+    uint32_t pool_blk_size;   // multiple of pointer size
+    uint32_t pool_blk_num;    // 1 ~ TOS_MEMPOOL_BLK_NUM_MAX
+} tos_mempool_attr_t;
+
+typedef struct {
+    tos_mempool_t pool;
+    uint32_t      blk_size;
+    uint32_t      blk_num;
+    uint32_t      used;       // blocks allocated now
+    uint32_t      used_max;   // high-water of used
+    uint32_t      fail_cnt;   // alloc when empty
+    bool          kernel;     // pool of kernel objects, see TOS_MEMPOOL_KERNEL_ENABLE
+} tos_mempool_stat_t;
+
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @param attr
+ * @return int
+ */
+int tos_mempool_init(tos_mempool_t* pool, const tos_mempool_attr_t* attr);
+
+/**
+ * @brief init pool in the storage given by caller, the heap is not used
+ *
+ * @param pool
+ * @param attr
+ * @param storage
+ * @return int
+ */
+int tos_mempool_init_static(tos_mempool_t* pool, const tos_mempool_attr_t* attr, tos_mempool_storage_t* storage);
+
+/**
+ * @brief get a block
+ *
+ * @param pool
+ * @return void* nullptr if no free block
+ * @note ISR safe, lock free
+ */
+void* tos_mempool_alloc(tos_mempool_t* pool);
+
+/**
+ * @brief put back a block
+ *
+ * @param pool
+ * @param blk
+ * @return int
+ * @note ISR safe, lock free
+ */
+int tos_mempool_free(tos_mempool_t* pool, void* blk);
+
+/**
+ * @brief
+ *
+ * @param pool
+ * @return int TOS_ERR_MEMPOOL_INUSE if blocks are not freed
+ */
+int tos_mempool_destroy(tos_mempool_t* pool);
+
+/**
+ * @brief snapshot stats of all pools
+ *
+ * @param stats buffer of stats
+ * @param num max number of stats
+ * @return uint32_t number of stats stored
+ */
+uint32_t tos_get_mempool_stats(tos_mempool_stat_t* stats, uint32_t num);
+
+
+#endif
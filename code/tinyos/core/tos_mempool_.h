@@ -0,0 +1,60 @@
+/**
+ * @file tos_mempool_.h
+ * @brief fixed-block memory pool
+ * @note private, not for user
+ */
+
+#ifndef _TOS_MEMPOOL__H_
+#define _TOS_MEMPOOL__H_
+
+
+#include "tos_config.h"
+#include "tos_mempool.h"
+#include "tos_types.h"
+#include "util_queue.h"
+
+
+typedef struct tos_mempool_intenal_t {
+    uint32_t           valid_flag;
+    uint8_t*           buffer;
+    uint32_t           blk_size;
+    uint32_t           blk_num;
+    volatile uintptr_t free_head;   // (tag << 16) | index of the first free block, tag against ABA
+    volatile uintptr_t used;        // updated by CAS
+    volatile uintptr_t used_max;
+    volatile uintptr_t fail_cnt;
+    util_queue_node_t  all_link;    // link into list of all pools
+    bool               is_static;   // storage is given by user, not freed by destroy
+    bool               kernel;
+} tos_mempool_intenal_t;
+
+
+#if TOS_MEMPOOL_KERNEL_ENABLE
+/**
+ * @brief create pools of kernel objects, buffers are from the heap once
+ *
+ * @return true
+ * @return false
+ */
+bool tos_mempool_kernel_init(void);
+
+/**
+ * @brief get a block from the smallest kernel pool fits
+ *
+ * @param size
+ * @return void* nullptr if too large or all pools fit are empty
+ */
+void* tos_mempool_kernel_alloc(tos_size_t size);
+
+/**
+ * @brief
+ *
+ * @param ptr
+ * @return true block of kernel pools, freed
+ * @return false not of kernel pools
+ */
+bool tos_mempool_kernel_free(void* ptr);
+#endif
+
+
+#endif
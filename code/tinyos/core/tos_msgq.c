@@ -0,0 +1,432 @@
+/**
+ * @file tos_msgq.c
+ * @brief message queue
+ * @note messages are handed to the highest prio waiter directly, the copy of send/recv is done out of the
+ *       critical section
+ */
+
+#include "tos_msgq.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_mem.h"
+#include "tos_msgq_.h"
+#include "tos_trace_.h"
+
+#include <string.h>
+
+#define MSGQ_VALID_FLAG   0x5A5A5A5A
+#define MSGQ_INVALID_FLAG 0xFFFFFFFF
+
+
+static int   tos_msgq_check_attr(const tos_msgq_attr_t* attr);
+static void  tos_msgq_setup(tos_msgq_intenal_t* msgq_intenal, const tos_msgq_attr_t* attr, bool is_static);
+static int   tos_msgq_get(tos_msgq_t* msgq, tos_msgq_intenal_t** msgq_intenal);
+static int   tos_msgq_take(tos_msgq_t* msgq, void** msg, uint32_t try_nms, bool to_write);
+static int   tos_msgq_give(tos_msgq_t* msgq, bool to_write);
+static void* tos_msgq_claim(tos_msgq_intenal_t* msgq_intenal, bool to_write);
+static bool  tos_msgq_wakeup(tos_msgq_intenal_t* msgq_intenal, bool to_write);
+
+
+/**
+ * @brief
+ *
+ * @param msgq
+ * @param attr
+ * @return int
+ */
+int tos_msgq_init(tos_msgq_t* msgq, const tos_msgq_attr_t* attr)
+{
+    if (msgq == nullptr) {
+        return TOS_ERR_MSGQ_NULLPTR;
+    }
+
+    int ret = tos_msgq_check_attr(attr);
+    if (ret != 0) {
+        *msgq = nullptr;
+        return ret;
+    }
+
+    // get a free msgq
+    tos_msgq_intenal_t* msgq_intenal = (tos_msgq_intenal_t*)tos_malloc(sizeof(tos_msgq_intenal_t));
+    if (msgq_intenal == nullptr) {
+        *msgq = nullptr;
+        return TOS_ERR_MSGQ_NOFREE;
+    }
+
+    *msgq = msgq_intenal;
+    tos_msgq_setup(msgq_intenal, attr, false);
+
+    return 0;
+}
+
+
+/**
+ * @brief init msgq in the storage given by caller, the heap is not used
+ *
+ * @param msgq
+ * @param attr
+ * @param storage static or global storage, alive until the msgq is destroyed
+ * @return int
+ */
+int tos_msgq_init_static(tos_msgq_t* msgq, const tos_msgq_attr_t* attr, tos_msgq_storage_t* storage)
+{
+    if (msgq == nullptr || storage == nullptr) {
+        return TOS_ERR_MSGQ_NULLPTR;
+    }
+
+    int ret = tos_msgq_check_attr(attr);
+    if (ret != 0) {
+        *msgq = nullptr;
+        return ret;
+    }
+
+    *msgq = storage;
+    tos_msgq_setup(storage, attr, true);
+
+    return 0;
+}
+
+
+int tos_msgq_send(tos_msgq_t* msgq, const void* msg, uint32_t try_nms)
+{
+    void* slot;
+
+    int ret = tos_msgq_take(msgq, &slot, try_nms, true);
+    if (ret != 0) {
+        return ret;
+    }
+
+    memcpy(slot, msg, (*msgq)->msg_size);
+    return tos_msgq_give(msgq, true);
+}
+
+
+int tos_msgq_recv(tos_msgq_t* msgq, void* msg, uint32_t try_nms)
+{
+    void* slot;
+
+    int ret = tos_msgq_take(msgq, &slot, try_nms, false);
+    if (ret != 0) {
+        return ret;
+    }
+
+    memcpy(msg, slot, (*msgq)->msg_size);
+    return tos_msgq_give(msgq, false);
+}
+
+
+int tos_msgq_reserve(tos_msgq_t* msgq, void** msg, uint32_t try_nms)
+{
+    return tos_msgq_take(msgq, msg, try_nms, true);
+}
+
+
+int tos_msgq_commit(tos_msgq_t* msgq)
+{
+    return tos_msgq_give(msgq, true);
+}
+
+
+int tos_msgq_acquire(tos_msgq_t* msgq, void** msg, uint32_t try_nms)
+{
+    return tos_msgq_take(msgq, msg, try_nms, false);
+}
+
+
+int tos_msgq_release(tos_msgq_t* msgq)
+{
+    return tos_msgq_give(msgq, false);
+}
+
+
+/**
+ * @brief
+ *
+ * @param msgq
+ * @return int
+ */
+int tos_msgq_destroy(tos_msgq_t* msgq)
+{
+    tos_msgq_intenal_t* msgq_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_msgq_get(msgq, &msgq_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    if (!tos_wait_queue_empty(&msgq_intenal->send_list) || !tos_wait_queue_empty(&msgq_intenal->recv_list)
+        || msgq_intenal->writing_cnt != 0 || msgq_intenal->reading_cnt != 0) {
+        tos_leave_critical_section();
+        return TOS_ERR_MSGQ_BLOCKING;
+    }
+
+    msgq_intenal->valid_flag = MSGQ_INVALID_FLAG;
+
+    tos_leave_critical_section();
+
+    if (!msgq_intenal->is_static) {
+        tos_free(msgq_intenal);
+    }
+
+    *msgq = nullptr;
+
+    return 0;
+}
+
+
+static int tos_msgq_check_attr(const tos_msgq_attr_t* attr)
+{
+    if (attr == nullptr || attr->msgq_buffer == nullptr) {
+        return TOS_ERR_MSGQ_NULLPTR;
+    }
+
+    if (attr->msgq_msg_size == 0 || attr->msgq_msg_num == 0) {
+        return TOS_ERR_MSGQ_PARAM;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief init msgq in its storage, all messages are free
+ *
+ * @param msgq_intenal
+ * @param attr
+ * @param is_static
+ */
+static void tos_msgq_setup(tos_msgq_intenal_t* msgq_intenal, const tos_msgq_attr_t* attr, bool is_static)
+{
+    msgq_intenal->buffer      = (uint8_t*)attr->msgq_buffer;
+    msgq_intenal->msg_size    = attr->msgq_msg_size;
+    msgq_intenal->msg_num     = attr->msgq_msg_num;
+    msgq_intenal->write_pos   = 0;
+    msgq_intenal->read_pos    = 0;
+    msgq_intenal->free_cnt    = attr->msgq_msg_num;
+    msgq_intenal->ready_cnt   = 0;
+    msgq_intenal->writing_cnt = 0;
+    msgq_intenal->written_cnt = 0;
+    msgq_intenal->reading_cnt = 0;
+    msgq_intenal->read_cnt    = 0;
+    msgq_intenal->is_static   = is_static;
+    tos_wait_queue_init(&(msgq_intenal->send_list));
+    tos_wait_queue_init(&(msgq_intenal->recv_list));
+    msgq_intenal->valid_flag = MSGQ_VALID_FLAG;
+}
+
+
+/**
+ * @brief check the msgq handle
+ *
+ * @param msgq
+ * @param msgq_intenal
+ * @return int
+ * @note called in critical section
+ */
+static int tos_msgq_get(tos_msgq_t* msgq, tos_msgq_intenal_t** msgq_intenal)
+{
+    if (msgq == nullptr || *msgq == nullptr) {
+        return TOS_ERR_MSGQ_NULLPTR;
+    }
+
+    if ((*msgq)->valid_flag != MSGQ_VALID_FLAG) {
+        return TOS_ERR_MSGQ_INVALID;
+    }
+
+    *msgq_intenal = *msgq;
+    return 0;
+}
+
+
+/**
+ * @brief take a free message to write, or a ready message to read, block if there is none
+ *
+ * @param msgq
+ * @param msg
+ * @param try_nms
+ * @param to_write
+ * @return int
+ */
+static int tos_msgq_take(tos_msgq_t* msgq, void** msg, uint32_t try_nms, bool to_write)
+{
+    tos_msgq_intenal_t* msgq_intenal;
+    tos_use_critical_section();
+
+    if (msg == nullptr) {
+        return TOS_ERR_MSGQ_NULLPTR;
+    }
+
+    tos_enter_critical_section();
+
+    int ret = tos_msgq_get(msgq, &msgq_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    // 1 message is available, a task holding it can not be deleted
+    if ((to_write ? msgq_intenal->free_cnt : msgq_intenal->ready_cnt) > 0) {
+        *msg = tos_msgq_claim(msgq_intenal, to_write);
+        if (tos_state.intr_level == 0 && tos_get_current_task() != nullptr) {
+            tos_get_current_task()->task_msgq_held++;
+        }
+        tos_leave_critical_section();
+        return 0;
+    }
+
+    // 2.1 immediately, ISR can not wait
+    if (try_nms == TOS_MSGQ_WAIT_IMMEDIATE || tos_state.intr_level > 0) {
+        tos_leave_critical_section();
+        return TOS_ERR_MSGQ_TIMEOUT;
+    }
+
+    // 2.2 wait message
+    // add current task to pending list
+    tos_task_tcb_t* current_task = tos_get_current_task();
+    tos_trace(TOS_TRACE_MSGQ_PEND, tos_trace_obj(msgq_intenal));
+    current_task->task_flag &= ~TOS_TASK_FLAG_WAIT_OK;
+    tos_ready_list_remove(current_task);
+    tos_wait_queue_insert(to_write ? &msgq_intenal->send_list : &msgq_intenal->recv_list, current_task);
+
+    // add current task into waiting list
+    if (try_nms != TOS_MSGQ_WAIT_INFINITE) {
+        tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
+    }
+    tos_leave_critical_section();
+
+    tos_schedule();
+
+    // the message is handed over, or timeout
+    if ((current_task->task_flag & TOS_TASK_FLAG_WAIT_OK) == 0) {
+        return TOS_ERR_MSGQ_TIMEOUT;
+    }
+    *msg = current_task->task_wait_data;
+    return 0;
+}
+
+
+/**
+ * @brief give back a message taken by tos_msgq_take, publish messages when no one is in hands
+ *
+ * @param msgq
+ * @param to_write the message is taken to write
+ * @return int
+ */
+static int tos_msgq_give(tos_msgq_t* msgq, bool to_write)
+{
+    tos_msgq_intenal_t* msgq_intenal;
+    bool                woken;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_msgq_get(msgq, &msgq_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    if (to_write) {
+        if (msgq_intenal->writing_cnt == 0) {
+            tos_leave_critical_section();
+            return TOS_ERR_MSGQ_PARAM;
+        }
+        tos_trace(TOS_TRACE_MSGQ_SEND, tos_trace_obj(msgq_intenal));
+        msgq_intenal->writing_cnt--;
+        msgq_intenal->written_cnt++;
+        if (msgq_intenal->writing_cnt == 0) {
+            msgq_intenal->ready_cnt += msgq_intenal->written_cnt;
+            msgq_intenal->written_cnt = 0;
+        }
+    } else {
+        if (msgq_intenal->reading_cnt == 0) {
+            tos_leave_critical_section();
+            return TOS_ERR_MSGQ_PARAM;
+        }
+        msgq_intenal->reading_cnt--;
+        msgq_intenal->read_cnt++;
+        if (msgq_intenal->reading_cnt == 0) {
+            msgq_intenal->free_cnt += msgq_intenal->read_cnt;
+            msgq_intenal->read_cnt = 0;
+        }
+    }
+
+    // taken by the task, or by ISR which is not counted
+    tos_task_tcb_t* current_task = tos_get_current_task();
+    if (tos_state.intr_level == 0 && current_task != nullptr && current_task->task_msgq_held > 0) {
+        current_task->task_msgq_held--;
+    }
+
+    // messages written wakeup receivers, and messages read wakeup senders
+    woken = tos_msgq_wakeup(msgq_intenal, !to_write);
+
+    tos_leave_critical_section();
+
+    if (woken) {
+        tos_schedule();
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief claim the next free message to write, or the next ready message to read
+ *
+ * @param msgq_intenal
+ * @param to_write
+ * @return void* the message
+ * @note called in critical section, the message should be available
+ */
+static void* tos_msgq_claim(tos_msgq_intenal_t* msgq_intenal, bool to_write)
+{
+    uint32_t* pos = to_write ? &msgq_intenal->write_pos : &msgq_intenal->read_pos;
+    uint8_t*  msg = msgq_intenal->buffer + *pos * msgq_intenal->msg_size;
+
+    *pos = (*pos + 1 == msgq_intenal->msg_num) ? 0 : *pos + 1;
+    if (to_write) {
+        msgq_intenal->free_cnt--;
+        msgq_intenal->writing_cnt++;
+    } else {
+        msgq_intenal->ready_cnt--;
+        msgq_intenal->reading_cnt++;
+        tos_trace(TOS_TRACE_MSGQ_RECV, tos_trace_obj(msgq_intenal));
+    }
+
+    return msg;
+}
+
+
+/**
+ * @brief hand available messages to the waiting tasks, highest prio first
+ *
+ * @param msgq_intenal
+ * @param to_write wakeup senders or receivers
+ * @return true if any task is woken up
+ * @note called in critical section
+ */
+static bool tos_msgq_wakeup(tos_msgq_intenal_t* msgq_intenal, bool to_write)
+{
+    tos_wait_queue_t* queue = to_write ? &msgq_intenal->send_list : &msgq_intenal->recv_list;
+    uint32_t*         cnt   = to_write ? &msgq_intenal->free_cnt : &msgq_intenal->ready_cnt;
+    bool              woken = false;
+
+    while (*cnt > 0 && !tos_wait_queue_empty(queue)) {
+        tos_task_tcb_t* hignest_prio_task = tos_wait_queue_first(queue);
+        tos_wait_queue_remove(hignest_prio_task);
+        tos_waiting_list_remove(hignest_prio_task);
+        hignest_prio_task->task_wait_data = tos_msgq_claim(msgq_intenal, to_write);
+        hignest_prio_task->task_msgq_held++;
+        hignest_prio_task->task_flag |= TOS_TASK_FLAG_WAIT_OK;
+        tos_ready_list_insert(hignest_prio_task);
+        tos_task_wakeup_stamp(hignest_prio_task);
+        woken = true;
+    }
+
+    return woken;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file tos_msgq.h
+ * @brief message queue, fixed-size messages in a buffer given by caller
+ * @note messages are copied by send/recv, or written and read in place by reserve/commit and acquire/release.
+ *       calls with TOS_MSGQ_WAIT_IMMEDIATE are ISR safe.
+ *       messages in hands are published only when all of them are given back, so a message reserved or
+ *       acquired is committed or released by the same task, and soon. tos_task_delete fails on a task
+ *       holding messages, and a task proc returning with messages in hands blocks forever
+ */
+
+#ifndef _TOS_MSGQ_H_
+#define _TOS_MSGQ_H_
+
+
+#include "tos_core.h"
+#include "tos_types.h"
+
+
+#define TOS_ERR_MSGQ_NULLPTR    -1
+#define TOS_ERR_MSGQ_NOFREE     -2
+#define TOS_ERR_MSGQ_TIMEOUT    -3
+#define TOS_ERR_MSGQ_PARAM      -4   // invalid attr, or commit/release without reserve/acquire
+#define TOS_ERR_MSGQ_BLOCKING   -6   // blocking or messages in use when destroy
+#define TOS_ERR_MSGQ_INVALID    -7
+
+#define TOS_MSGQ_WAIT_INFINITE  0xFFFFFFFFu
+#define TOS_MSGQ_WAIT_IMMEDIATE 0
+
+
+typedef struct tos_msgq_intenal_t* tos_msgq_t;
+typedef struct tos_msgq_intenal_t  tos_msgq_storage_t;   // storage for tos_msgq_init_static, see tos_static.h
+
+typedef struct {
+    void*    msgq_buffer;     // msgq_msg_size * msgq_msg_num bytes, alive until the msgq is destroyed
+    uint32_t msgq_msg_size;   // bytes of a message, keep it aligned for messages of structs
+    uint32_t msgq_msg_num;    // max messages in the queue
+} tos_msgq_attr_t;
+
+
+/**
+ * @brief
+ *
+ * @param msgq
+ * @param attr
+ * @return int
+ */
+int tos_msgq_init(tos_msgq_t* msgq, const tos_msgq_attr_t* attr);
+
+/**
+ * @brief init msgq in the storage given by caller, the heap is not used
+ *
+ * @param msgq
+ * @param attr
+ * @param storage
+ * @return int
+ */
+int tos_msgq_init_static(tos_msgq_t* msgq, const tos_msgq_attr_t* attr, tos_msgq_storage_t* storage);
+
+/**
+ * @brief copy a message into the queue, wait at most try_nms if it's full
+ *
+ * @param msgq
+ * @param msg msgq_msg_size bytes
+ * @param try_nms
+ * @return int
+ */
+int tos_msgq_send(tos_msgq_t* msgq, const void* msg, uint32_t try_nms);
+
+/**
+ * @brief copy the oldest message out, wait at most try_nms if it's empty
+ *
+ * @param msgq
+ * @param msg buffer of msgq_msg_size bytes
+ * @param try_nms
+ * @return int
+ */
+int tos_msgq_recv(tos_msgq_t* msgq, void* msg, uint32_t try_nms);
+
+/**
+ * @brief reserve a free message to write in place, wait at most try_nms if it's full
+ *
+ * @param msgq
+ * @param msg message in the buffer of msgq
+ * @param try_nms
+ * @return int
+ * @note the message is received after tos_msgq_commit. if several are reserved at the same time, they are
+ *       received after all of them are committed
+ */
+int tos_msgq_reserve(tos_msgq_t* msgq, void** msg, uint32_t try_nms);
+
+/**
+ * @brief send a message reserved by tos_msgq_reserve
+ *
+ * @param msgq
+ * @return int
+ */
+int tos_msgq_commit(tos_msgq_t* msgq);
+
+/**
+ * @brief take the oldest message to read in place, wait at most try_nms if it's empty
+ *
+ * @param msgq
+ * @param msg message in the buffer of msgq
+ * @param try_nms
+ * @return int
+ * @note the message is reused after tos_msgq_release. if several are acquired at the same time, they are
+ *       reused after all of them are released
+ */
+int tos_msgq_acquire(tos_msgq_t* msgq, void** msg, uint32_t try_nms);
+
+/**
+ * @brief give back a message taken by tos_msgq_acquire
+ *
+ * @param msgq
+ * @return int
+ */
+int tos_msgq_release(tos_msgq_t* msgq);
+
+/**
+ * @brief
+ *
+ * @param msgq
+ * @return int
+ */
+int tos_msgq_destroy(tos_msgq_t* msgq);
+
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file tos_msgq_.h
+ * @brief message queue
+ * @note private, not for user
+ */
+
+#ifndef _TOS_MSGQ__H_
+#define _TOS_MSGQ__H_
+
+
+#include "tos_core_.h"
+#include "tos_msgq.h"
+
+
+/*
+ messages move around the ring: free -> writing -> written -> ready -> reading -> read -> free.
+ writing/reading are in the hands of tasks, written/read messages are published together when the
+ last one in hands is given back, so ready and free messages are always contiguous in the ring.
+ a task is not deleted while it holds messages, see task_msgq_held
+ */
+typedef struct tos_msgq_intenal_t {
+    uint32_t         valid_flag;
+    uint8_t*         buffer;
+    uint32_t         msg_size;
+    uint32_t         msg_num;
+    uint32_t         write_pos;      // next message to reserve
+    uint32_t         read_pos;       // next message to acquire
+    uint32_t         free_cnt;       // messages to reserve
+    uint32_t         ready_cnt;      // messages to acquire
+    uint32_t         writing_cnt;    // reserved, not committed
+    uint32_t         written_cnt;    // committed, wait for the others in writing
+    uint32_t         reading_cnt;    // acquired, not released
+    uint32_t         read_cnt;       // released, wait for the others in reading
+    tos_wait_queue_t send_list;      // tasks waiting for free messages
+    tos_wait_queue_t recv_list;      // tasks waiting for ready messages
+    bool             is_static;      // storage is given by user, not freed by destroy
+} tos_msgq_intenal_t;
+
+
+#endif
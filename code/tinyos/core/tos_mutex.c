@@ -8,7 +8,10 @@
 #include "tos_config.h"
 #include "tos_core.h"
 #include "tos_core_.h"
+#include "tos_cpu.h"
 #include "tos_mem.h"
+#include "tos_mutex_.h"
+#include "tos_trace_.h"
 #include "util_misc.h"
 #include "util_queue.h"
 
@@ -16,13 +19,13 @@
 #define MUTEX_INVALID_FLAG 0xFFFFFFFF
 
 
-typedef struct tos_mutex_intenal_t {
-    uint32_t          valid_flag;
-    bool              lock_flag;
-    tos_task_tcb_t*   owner;
-    util_queue_node_t pending_list;
-    util_queue_node_t queue_link;
-} tos_mutex_intenal_t;
+static void tos_mutex_setup(tos_mutex_intenal_t* mutex_intenal, bool is_static);
+static bool tos_mutex_check(tos_mutex_intenal_t* mutex_intenal);
+static void tos_mutex_pend(tos_mutex_intenal_t* mutex_intenal, tos_task_tcb_t* tcb);
+static tos_task_tcb_t* tos_mutex_hand_over(tos_mutex_intenal_t* mutex_intenal);
+
+
+static util_queue_node_t tos_mutex_all_list = {&tos_mutex_all_list, &tos_mutex_all_list};   // all mutexes
 
 
 /**
@@ -46,11 +49,28 @@ int tos_mutex_init(tos_mutex_t* mutex, const tos_mutex_attr_t* attr)
     }
 
     *mutex = mutex_intenal;
+    tos_mutex_setup(mutex_intenal, false);
 
-    mutex_intenal->lock_flag  = false;
-    mutex_intenal->valid_flag = MUTEX_VALID_FLAG;
-    mutex_intenal->owner      = nullptr;
-    util_queue_init(&(mutex_intenal->pending_list));
+    return 0;
+}
+
+
+/**
+ * @brief init mutex in the storage given by caller, the heap is not used
+ *
+ * @param mutex
+ * @param attr
+ * @param storage static or global storage, alive until the mutex is destroyed
+ * @return int
+ */
+int tos_mutex_init_static(tos_mutex_t* mutex, const tos_mutex_attr_t* attr, tos_mutex_storage_t* storage)
+{
+    if (mutex == nullptr || storage == nullptr) {
+        return TOS_ERR_MUTEX_NULLPTR;
+    }
+
+    *mutex = storage;
+    tos_mutex_setup(storage, true);
 
     return 0;
 }
@@ -81,6 +101,18 @@ int tos_mutex_trylock(tos_mutex_t* mutex, uint32_t try_nms)
         return TOS_ERR_MUTEX_NULLPTR;
     }
 
+    tos_task_tcb_t* current_task = tos_get_current_task();
+
+    // fast path, mutex is usable, own it without masking irq. counted before own, the count is never less
+    tos_mutex_intenal_t* mutex_intenal = *mutex;
+    current_task->task_mutex_held++;
+    if (mutex_intenal != nullptr && mutex_intenal->valid_flag == MUTEX_VALID_FLAG
+        && tos_cpu_cas(&mutex_intenal->owner, 0, (uintptr_t)current_task)) {
+        tos_trace(TOS_TRACE_MUTEX_LOCK, tos_trace_obj(mutex_intenal));
+        return 0;
+    }
+    current_task->task_mutex_held--;
+
     tos_use_critical_section();
     tos_enter_critical_section();
 
@@ -88,18 +120,19 @@ int tos_mutex_trylock(tos_mutex_t* mutex, uint32_t try_nms)
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_NULLPTR;
     }
-    tos_mutex_intenal_t* mutex_intenal = *mutex;
+    mutex_intenal = *mutex;
 
     // mutex is invalid
-    if (mutex_intenal->valid_flag != MUTEX_VALID_FLAG) {
+    if (!tos_mutex_check(mutex_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_INVALID;
     }
 
-    // 1 mutex is usable
-    if (mutex_intenal->lock_flag == false) {
-        mutex_intenal->lock_flag = true;
-        mutex_intenal->owner     = tos_get_current_task();   // own task
+    // 1 mutex is usable (unlocked after the fast path)
+    if (mutex_intenal->owner == 0) {
+        mutex_intenal->owner = (uintptr_t)current_task;   // own task
+        current_task->task_mutex_held++;
+        tos_trace(TOS_TRACE_MUTEX_LOCK, tos_trace_obj(mutex_intenal));
         tos_leave_critical_section();
         return 0;
     }
@@ -114,23 +147,34 @@ int tos_mutex_trylock(tos_mutex_t* mutex, uint32_t try_nms)
 
     // 2.2 wait mutex
     // add current task to pending list
-    tos_task_tcb_t* current_task = tos_get_current_task();
-    util_queue_remove(&current_task->ready_pending_link);
-    if (util_queue_empty(&tos_state.ready_task_list[current_task->task_prio])) {
-        tos_state.ready_task_prio_mask &= ~current_task->task_prio_mask;
-    }
-    util_queue_insert(&mutex_intenal->pending_list, &current_task->ready_pending_link);
+    tos_trace(TOS_TRACE_MUTEX_CONTEND, tos_trace_obj(mutex_intenal));
+    tos_ready_list_remove(current_task);
+    tos_mutex_pend(mutex_intenal, current_task);
 
     // add current task into waiting list
     if (try_nms != TOS_TRY_LOCK_INFINITE) {
-        current_task->task_wait_time = try_nms / TOS_TICK_MS;
-        util_queue_insert(&tos_state.waiting_task_list, &current_task->waiting_link);
+        tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
     }
+
+#if TOS_LATENCY_STAT_ENABLE
+    uint32_t pend_cycles = tos_cpu_cycles();
+#endif
+
     tos_leave_critical_section();
 
     tos_schedule();
 
-    return (mutex_intenal->owner == current_task) ? 0 : TOS_ERR_MUTEX_TIMEOUT;
+#if TOS_LATENCY_STAT_ENABLE
+    tos_enter_critical_section();
+    tos_hist_add(&mutex_intenal->wait_hist, tos_cpu_cycles() - pend_cycles);
+    tos_leave_critical_section();
+#endif
+
+    if (tos_mutex_owner(mutex_intenal) != current_task) {
+        return TOS_ERR_MUTEX_TIMEOUT;
+    }
+    tos_trace(TOS_TRACE_MUTEX_LOCK, tos_trace_obj(mutex_intenal));
+    return 0;
 }
 
 
@@ -146,6 +190,17 @@ int tos_mutex_unlock(tos_mutex_t* mutex)
         return TOS_ERR_MUTEX_NULLPTR;
     }
 
+    tos_task_tcb_t* current_task = tos_get_current_task();
+
+    // fast path, no task has waited for the mutex, release it without masking irq
+    tos_mutex_intenal_t* mutex_intenal = *mutex;
+    if (mutex_intenal != nullptr && mutex_intenal->valid_flag == MUTEX_VALID_FLAG
+        && tos_cpu_cas(&mutex_intenal->owner, (uintptr_t)current_task, 0)) {
+        current_task->task_mutex_held--;
+        tos_trace(TOS_TRACE_MUTEX_UNLOCK, tos_trace_obj(mutex_intenal));
+        return 0;
+    }
+
     tos_use_critical_section();
     tos_enter_critical_section();
 
@@ -153,41 +208,43 @@ int tos_mutex_unlock(tos_mutex_t* mutex)
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_NULLPTR;
     }
-    tos_mutex_intenal_t* mutex_intenal = *mutex;
+    mutex_intenal = *mutex;
 
     // mutex is invalid
-    if (mutex_intenal->valid_flag != MUTEX_VALID_FLAG) {
+    if (!tos_mutex_check(mutex_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_INVALID;
     }
 
     // mutex is unlock
-    if (mutex_intenal->lock_flag == false) {
+    if (mutex_intenal->owner == 0) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_UNLOCKED;
     }
 
     // mutex not own by current task
-    if (mutex_intenal->owner != tos_get_current_task()) {
+    if (tos_mutex_owner(mutex_intenal) != current_task) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_PERM;
     }
 
+    tos_trace(TOS_TRACE_MUTEX_UNLOCK, tos_trace_obj(mutex_intenal));
+    util_queue_remove(&mutex_intenal->queue_link);
+    util_queue_init(&mutex_intenal->queue_link);
+    current_task->task_mutex_held--;
+
     // pending list is empty
-    if (util_queue_empty(&mutex_intenal->pending_list)) {
-        mutex_intenal->lock_flag = false;
-        mutex_intenal->owner     = nullptr;
+    if (tos_wait_queue_empty(&mutex_intenal->pending_list)) {
+        mutex_intenal->owner = 0;
+        tos_mutex_prio_update(current_task);
         tos_leave_critical_section();
         return 0;
     }
 
-    // active next pending task
-    tos_task_tcb_t* next_task = get_task_by_ready_pending_link(mutex_intenal->pending_list.next);
-    util_queue_remove(&next_task->ready_pending_link);   // in blocking list now
-    util_queue_remove(&next_task->waiting_link);
-    util_queue_insert(&tos_state.ready_task_list[next_task->task_prio], &next_task->ready_pending_link);
-    tos_state.ready_task_prio_mask |= next_task->task_prio_mask;
-    mutex_intenal->owner = next_task;
+    // give back the prio inherited from this mutex, and the new owner inherits from the rest waiters
+    tos_task_tcb_t* next_task = tos_mutex_hand_over(mutex_intenal);
+    tos_mutex_prio_update(current_task);
+    tos_mutex_prio_update(next_task);
 
     tos_leave_critical_section();
 
@@ -219,25 +276,223 @@ int tos_mutex_destroy(tos_mutex_t* mutex)
     tos_mutex_intenal_t* mutex_intenal = *mutex;
 
     // mutex is invalid
-    if (mutex_intenal->valid_flag != MUTEX_VALID_FLAG) {
+    if (!tos_mutex_check(mutex_intenal)) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_INVALID;
     }
 
     // mutex is locking or pending
-    // if (!util_queue_empty(&mutex_intenal->pending_list) || mutex_intenal->lock_flag == true) {
-    if (mutex_intenal->owner != nullptr) {
+    if (mutex_intenal->owner != 0) {
         tos_leave_critical_section();
         return TOS_ERR_MUTEX_BLOCKING;
     }
 
     mutex_intenal->valid_flag = MUTEX_INVALID_FLAG;
+    util_queue_remove(&mutex_intenal->all_link);
 
     tos_leave_critical_section();
 
-    tos_free(mutex_intenal);
+    if (!mutex_intenal->is_static) {
+        tos_free(mutex_intenal);
+    }
 
     *mutex = nullptr;
 
     return 0;
 }
+
+
+uint32_t tos_get_mutex_stats(tos_mutex_stat_t* stats, uint32_t num)
+{
+    uint32_t count = 0;
+
+#if TOS_LATENCY_STAT_ENABLE
+    tos_use_critical_section();
+
+    if (stats == nullptr) {
+        return 0;
+    }
+
+    tos_enter_critical_section();
+    util_queue_foreach(node, &tos_mutex_all_list)
+    {
+        tos_mutex_intenal_t* mutex_intenal = util_containerof(tos_mutex_intenal_t, all_link, node);
+
+        if (count >= num) {
+            break;
+        }
+        stats[count].mutex     = mutex_intenal;
+        stats[count].owner     = tos_mutex_owner(mutex_intenal);
+        stats[count].wait_hist = mutex_intenal->wait_hist;
+        count++;
+    }
+    tos_leave_critical_section();
+#endif
+
+    return count;
+}
+
+
+void tos_mutex_lock_for(tos_mutex_intenal_t* mutex_intenal, tos_task_tcb_t* tcb)
+{
+    // mutex is usable, own it and run
+    if (mutex_intenal->owner == 0) {
+        mutex_intenal->owner = (uintptr_t)tcb;
+        tcb->task_mutex_held++;
+        tos_ready_list_insert(tcb);
+        tos_task_wakeup_stamp(tcb);
+        return;
+    }
+
+    // mutex is locked, wait without timeout
+    tos_mutex_pend(mutex_intenal, tcb);
+}
+
+
+bool tos_mutex_release_all(tos_task_tcb_t* tcb)
+{
+    bool woken = false;
+
+    if (tcb->task_mutex_held == 0) {
+        return false;
+    }
+
+    util_queue_foreach(node, &tos_mutex_all_list)
+    {
+        tos_mutex_intenal_t* mutex_intenal = util_containerof(tos_mutex_intenal_t, all_link, node);
+
+        if (tos_mutex_owner(mutex_intenal) != tcb) {
+            continue;
+        }
+
+        tos_trace(TOS_TRACE_MUTEX_UNLOCK, tos_trace_obj(mutex_intenal));
+        util_queue_remove(&mutex_intenal->queue_link);
+        util_queue_init(&mutex_intenal->queue_link);
+        if (tos_wait_queue_empty(&mutex_intenal->pending_list)) {
+            mutex_intenal->owner = 0;
+        } else {
+            tos_mutex_prio_update(tos_mutex_hand_over(mutex_intenal));
+            woken = true;
+        }
+    }
+    tcb->task_mutex_held = 0;
+
+    return woken;
+}
+
+
+/**
+ * @brief init mutex in its storage
+ *
+ * @param mutex_intenal
+ * @param is_static
+ */
+static void tos_mutex_setup(tos_mutex_intenal_t* mutex_intenal, bool is_static)
+{
+    mutex_intenal->owner     = 0;
+    mutex_intenal->is_static = is_static;
+    tos_wait_queue_init(&(mutex_intenal->pending_list));
+    util_queue_init(&(mutex_intenal->queue_link));
+
+    tos_use_critical_section();
+
+#if TOS_LATENCY_STAT_ENABLE
+    memset(&mutex_intenal->wait_hist, 0, sizeof(mutex_intenal->wait_hist));
+#endif
+    tos_enter_critical_section();
+    util_queue_insert(&tos_mutex_all_list, &mutex_intenal->all_link);
+    tos_leave_critical_section();
+
+    mutex_intenal->valid_flag = MUTEX_VALID_FLAG;
+}
+
+
+/**
+ * @brief check mutex in slow paths, the one by TOS_MUTEX_INITIALIZER is setup at its first use
+ *
+ * @param mutex_intenal
+ * @return true if valid
+ * @note called in critical section
+ */
+static bool tos_mutex_check(tos_mutex_intenal_t* mutex_intenal)
+{
+    if (mutex_intenal->valid_flag == MUTEX_INITIALIZER_FLAG) {
+        tos_mutex_setup(mutex_intenal, true);
+    }
+
+    return mutex_intenal->valid_flag == MUTEX_VALID_FLAG;
+}
+
+
+/**
+ * @brief block task on the locked mutex, owner inherits prio of the task
+ *
+ * @param mutex_intenal
+ * @param tcb task not in ready list
+ * @note called in critical section, the owner can not be in the middle of the fast path, as the CAS of
+ *       an interrupted task fails
+ */
+static void tos_mutex_pend(tos_mutex_intenal_t* mutex_intenal, tos_task_tcb_t* tcb)
+{
+    // the first waiter makes unlock take the slow path, and links the mutex to owner for prio inheritance
+    if ((mutex_intenal->owner & MUTEX_CONTENDED) == 0) {
+        mutex_intenal->owner |= MUTEX_CONTENDED;
+        util_queue_insert(&tos_mutex_owner(mutex_intenal)->task_mutex_list, &mutex_intenal->queue_link);
+    }
+
+    tos_wait_queue_insert(&mutex_intenal->pending_list, tcb);
+    tcb->task_pending_mutex = mutex_intenal;
+    tos_mutex_prio_update(tos_mutex_owner(mutex_intenal));
+}
+
+
+void tos_mutex_prio_update(tos_task_tcb_t* tcb)
+{
+    while (tcb != nullptr) {
+        uint8_t prio = tcb->task_base_prio;
+
+        util_queue_foreach(node, &tcb->task_mutex_list)
+        {
+            tos_mutex_intenal_t* mutex_intenal = util_containerof(tos_mutex_intenal_t, queue_link, node);
+            prio                               = util_max2(prio, tos_wait_queue_highest_prio(&mutex_intenal->pending_list));
+        }
+
+        if (prio == tcb->task_prio) {
+            break;
+        }
+        tos_task_change_prio(tcb, prio);
+
+        // task is blocked by another mutex, pass the prio to its owner
+        if (tcb->task_state != TOS_TASK_STATE_PENDING || tcb->task_pending_mutex == nullptr) {
+            break;
+        }
+        tcb = tos_mutex_owner(tcb->task_pending_mutex);
+    }
+}
+
+
+/**
+ * @brief give the mutex to the waiter of the highest prio, and make it ready
+ *
+ * @param mutex_intenal unlocked by its owner, pending list is not empty
+ * @return tos_task_tcb_t* the new owner, its prio is not updated
+ * @note called in critical section
+ */
+static tos_task_tcb_t* tos_mutex_hand_over(tos_mutex_intenal_t* mutex_intenal)
+{
+    tos_task_tcb_t* next_task = tos_wait_queue_first(&mutex_intenal->pending_list);
+
+    tos_wait_queue_remove(next_task);
+    tos_waiting_list_remove(next_task);
+    tos_ready_list_insert(next_task);
+    tos_task_wakeup_stamp(next_task);
+    next_task->task_pending_mutex = nullptr;
+    next_task->task_mutex_held++;
+    mutex_intenal->owner = (uintptr_t)next_task;
+    if (!tos_wait_queue_empty(&mutex_intenal->pending_list)) {
+        mutex_intenal->owner |= MUTEX_CONTENDED;
+        util_queue_insert(&next_task->task_mutex_list, &mutex_intenal->queue_link);
+    }
+
+    return next_task;
+}
@@ -8,6 +8,7 @@
 #define _TOS_MUTEX_H_
 
 
+#include "tos_core.h"
 #include "tos_types.h"
 
 
@@ -24,17 +25,34 @@
 
 
 typedef struct tos_mutex_intenal_t* tos_mutex_t;
+typedef struct tos_mutex_intenal_t  tos_mutex_storage_t;   // storage for tos_mutex_init_static, see tos_static.h
 
 typedef struct {
     uint8_t resv;
 } tos_mutex_attr_t;
 
+typedef struct {
+    tos_mutex_t mutex;
+    tos_task_t  owner;       // nullptr if unlocked
+    tos_hist_t  wait_hist;   // cycles blocked in lock, include timeout
+} tos_mutex_stat_t;
+
 
 int tos_mutex_init(tos_mutex_t* mutex, const tos_mutex_attr_t* attr);
+int tos_mutex_init_static(tos_mutex_t* mutex, const tos_mutex_attr_t* attr, tos_mutex_storage_t* storage);
 int tos_mutex_lock(tos_mutex_t* mutex);
 int tos_mutex_trylock(tos_mutex_t* mutex, uint32_t try_nms);
 int tos_mutex_unlock(tos_mutex_t* mutex);
 int tos_mutex_destroy(tos_mutex_t* mutex);
 
+/**
+ * @brief snapshot stats of all mutexes
+ *
+ * @param stats buffer of stats
+ * @param num max number of stats
+ * @return uint32_t number of stats stored, 0 if TOS_LATENCY_STAT_ENABLE is 0
+ */
+uint32_t tos_get_mutex_stats(tos_mutex_stat_t* stats, uint32_t num);
+
 
 #endif
@@ -0,0 +1,72 @@
+/**
+ * @file tos_mutex_.h
+ * @brief
+ * @note private, not for user
+ */
+
+#ifndef _TOS_MUTEX__H_
+#define _TOS_MUTEX__H_
+
+
+#include "tos_core_.h"
+#include "tos_mutex.h"
+#include "util_queue.h"
+
+
+#define MUTEX_CONTENDED        1u            // in owner, tasks have waited for the mutex, unlock takes the slow path
+#define MUTEX_INITIALIZER_FLAG 0xA5A5A5A5u   // valid_flag by TOS_MUTEX_INITIALIZER, setup at the first use
+
+
+typedef struct tos_mutex_intenal_t {
+    uint32_t           valid_flag;
+    volatile uintptr_t owner;          // owner task | MUTEX_CONTENDED, 0 if unlocked, set by CAS
+    tos_wait_queue_t   pending_list;   // tasks waiting for the mutex
+    util_queue_node_t  queue_link;     // link into task_mutex_list of owner, only when contended
+    util_queue_node_t  all_link;       // link into list of all mutexes
+    bool               is_static;      // storage is given by user, not freed by destroy
+#if TOS_LATENCY_STAT_ENABLE
+    tos_hist_t wait_hist;   // cycles blocked in lock
+#endif
+} tos_mutex_intenal_t;
+
+
+static inline tos_task_tcb_t* tos_mutex_owner(const tos_mutex_intenal_t* mutex_intenal)
+{
+    return (tos_task_tcb_t*)(mutex_intenal->owner & ~(uintptr_t)MUTEX_CONTENDED);
+}
+
+
+
+/**
+ * @brief recalculate prio of task: the highest of its base prio and the waiters of mutexes it owns,
+ *        and pass the change along the chain of owners it is blocked by
+ *
+ * @param tcb
+ * @note called in critical section
+ */
+void tos_mutex_prio_update(tos_task_tcb_t* tcb);
+
+/**
+ * @brief lock the mutex on behalf of a blocked task, used by cond to wakeup waiters (wait morphing):
+ *        the task owns the mutex and gets ready if the mutex is free,
+ *        or moves to the pending list and gets ready when the mutex is handed over by unlock
+ *
+ * @param mutex_intenal
+ * @param tcb task removed from its wait queue and time waiting list
+ * @note called in critical section, no schedule
+ */
+void tos_mutex_lock_for(tos_mutex_intenal_t* mutex_intenal, tos_task_tcb_t* tcb);
+
+/**
+ * @brief unlock all mutexes owned by a task being deleted, each is handed over to its first waiter
+ *
+ * @param tcb removed from ready list, wait queue and time waiting list
+ * @return true some waiter is made ready
+ * @return false
+ * @note called in critical section, no schedule. mutexes locked by the fast path are not in task_mutex_list,
+ *       so all mutexes are looked through, only if task_mutex_held is not 0
+ */
+bool tos_mutex_release_all(tos_task_tcb_t* tcb);
+
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file tos_notify.c
+ * @brief direct-to-task notification
+ * @note the waiting task blocks in no wait queue, the notifier knows it by its tcb
+ */
+
+#include "tos_notify.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_trace_.h"
+#include "util_queue.h"
+
+
+/**
+ * @brief
+ *
+ * @param task
+ * @param value
+ * @param action
+ * @return int
+ */
+int tos_task_notify(tos_task_t* task, uint32_t value, tos_notify_action_t action)
+{
+    tos_use_critical_section();
+
+    if (task == nullptr || *task == nullptr) {
+        return TOS_ERR_NOTIFY_NULLPTR;
+    }
+
+    tos_task_tcb_t* tcb = *task;
+
+    tos_enter_critical_section();
+
+    switch (action) {
+    case TOS_NOTIFY_NONE:
+        break;
+    case TOS_NOTIFY_SET_BITS:
+        tcb->task_notify_value |= value;
+        break;
+    case TOS_NOTIFY_INCREMENT:
+        tcb->task_notify_value++;
+        break;
+    case TOS_NOTIFY_OVERWRITE:
+        tcb->task_notify_value = value;
+        break;
+    default:
+        tos_leave_critical_section();
+        return TOS_ERR_NOTIFY_PARAM;
+    }
+
+    tos_trace(TOS_TRACE_NOTIFY, tcb->task_id);
+
+    // not waiting, it's got by the next wait
+    if (tcb->task_notify_state != TOS_NOTIFY_STATE_WAITING) {
+        tcb->task_notify_state = TOS_NOTIFY_STATE_RECEIVED;
+        tos_leave_critical_section();
+        return 0;
+    }
+
+    // wakeup the task, it's still blocked as the timeout clears WAITING
+    tcb->task_notify_state = TOS_NOTIFY_STATE_RECEIVED;
+    tcb->task_flag |= TOS_TASK_FLAG_WAIT_OK;
+    tos_waiting_list_remove(tcb);
+    tos_ready_list_insert(tcb);
+    tos_task_wakeup_stamp(tcb);
+
+    tos_leave_critical_section();
+
+    tos_schedule();
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param clear_mask
+ * @param value
+ * @param try_nms
+ * @return int
+ */
+int tos_task_notify_wait(uint32_t clear_mask, uint32_t* value, uint32_t try_nms)
+{
+    tos_task_tcb_t* current_task = tos_get_current_task();
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    // 1 not notified yet
+    if (current_task->task_notify_state != TOS_NOTIFY_STATE_RECEIVED) {
+        // 1.1 immediately, ISR can not wait
+        if (try_nms == TOS_NOTIFY_WAIT_IMMEDIATE || tos_state.intr_level > 0) {
+            tos_leave_critical_section();
+            return TOS_ERR_NOTIFY_TIMEOUT;
+        }
+
+        // 1.2 block, in no wait queue
+        current_task->task_notify_state = TOS_NOTIFY_STATE_WAITING;
+        current_task->task_flag &= ~TOS_TASK_FLAG_WAIT_OK;
+        tos_ready_list_remove(current_task);
+        util_queue_init(&current_task->ready_pending_link);
+        current_task->task_state = TOS_TASK_STATE_PENDING;
+
+        // add current task into waiting list
+        if (try_nms != TOS_NOTIFY_WAIT_INFINITE) {
+            tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
+        }
+        tos_leave_critical_section();
+
+        tos_schedule();
+
+        tos_enter_critical_section();
+
+        // timeout, a notify arriving after it is kept for the next wait
+        if ((current_task->task_flag & TOS_TASK_FLAG_WAIT_OK) == 0) {
+            tos_leave_critical_section();
+            return TOS_ERR_NOTIFY_TIMEOUT;
+        }
+    }
+
+    // 2 notified
+    if (value != nullptr) {
+        *value = current_task->task_notify_value;
+    }
+    current_task->task_notify_value &= ~clear_mask;
+    current_task->task_notify_state = TOS_NOTIFY_STATE_NONE;
+
+    tos_leave_critical_section();
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file tos_notify.h
+ * @brief direct-to-task notification, a 32-bit value in the tcb of each task
+ * @note a light signal path for the case of waking exactly one known task, no kernel object is needed.
+ *       tos_task_notify is ISR safe
+ */
+
+#ifndef _TOS_NOTIFY_H_
+#define _TOS_NOTIFY_H_
+
+
+#include "tos_core.h"
+#include "tos_types.h"
+
+
+#define TOS_ERR_NOTIFY_NULLPTR    -1
+#define TOS_ERR_NOTIFY_TIMEOUT    -3
+#define TOS_ERR_NOTIFY_PARAM      -4   // invalid action
+
+#define TOS_NOTIFY_WAIT_INFINITE  0xFFFFFFFFu
+#define TOS_NOTIFY_WAIT_IMMEDIATE 0
+
+
+typedef enum {
+    TOS_NOTIFY_NONE = 0,    // wakeup only, value is not changed
+    TOS_NOTIFY_SET_BITS,    // value |= arg, like event flags
+    TOS_NOTIFY_INCREMENT,   // value++, like a counting semaphore
+    TOS_NOTIFY_OVERWRITE,   // value = arg, like a mailbox of one word
+} tos_notify_action_t;
+
+
+/**
+ * @brief update the notification value of task, wakeup it if it's waiting
+ *
+ * @param task
+ * @param value arg of action
+ * @param action
+ * @return int
+ * @note ISR safe, schedule is deferred to tos_exit_isr
+ */
+int tos_task_notify(tos_task_t* task, uint32_t value, tos_notify_action_t action);
+
+/**
+ * @brief current task waits for notification
+ *
+ * @param clear_mask bits of value cleared when return, 0xFFFFFFFF: reset value to 0
+ * @param value nullptr or value before cleared
+ * @param try_nms
+ * @return int
+ * @note notified before wait returns immediately, several notifications before wait are merged in one
+ */
+int tos_task_notify_wait(uint32_t clear_mask, uint32_t* value, uint32_t try_nms);
+
+
+#endif
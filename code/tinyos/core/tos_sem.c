@@ -0,0 +1,289 @@
+/**
+ * @file tos_sem.c
+ * @brief counting semaphore
+ * @note give hands the sem to the highest prio waiter directly, the count is only kept when no task waits
+ */
+
+#include "tos_sem.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_mem.h"
+#include "tos_sem_.h"
+#include "tos_trace_.h"
+
+#define SEM_VALID_FLAG   0x5A5A5A5A
+#define SEM_INVALID_FLAG 0xFFFFFFFF
+
+
+static void tos_sem_setup(tos_sem_intenal_t* sem_intenal, uint32_t count, const tos_sem_attr_t* attr, bool is_static);
+static bool tos_sem_check(tos_sem_intenal_t* sem_intenal);
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @param count
+ * @param attr
+ * @return int
+ */
+int tos_sem_init(tos_sem_t* sem, uint32_t count, const tos_sem_attr_t* attr)
+{
+    if (sem == nullptr) {
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    // get a free sem
+    tos_sem_intenal_t* sem_intenal = (tos_sem_intenal_t*)tos_malloc(sizeof(tos_sem_intenal_t));
+    if (sem_intenal == nullptr) {
+        *sem = nullptr;
+        return TOS_ERR_SEM_NOFREE;
+    }
+
+    *sem = sem_intenal;
+    tos_sem_setup(sem_intenal, count, attr, false);
+
+    return 0;
+}
+
+
+/**
+ * @brief init sem in the storage given by caller, the heap is not used
+ *
+ * @param sem
+ * @param count
+ * @param attr
+ * @param storage static or global storage, alive until the sem is destroyed
+ * @return int
+ */
+int tos_sem_init_static(tos_sem_t* sem, uint32_t count, const tos_sem_attr_t* attr, tos_sem_storage_t* storage)
+{
+    if (sem == nullptr || storage == nullptr) {
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    *sem = storage;
+    tos_sem_setup(storage, count, attr, true);
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @return int
+ */
+int tos_sem_take(tos_sem_t* sem)
+{
+    return tos_sem_trytake(sem, TOS_SEM_WAIT_INFINITE);
+}
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @param try_nms
+ * @return int
+ */
+int tos_sem_trytake(tos_sem_t* sem, uint32_t try_nms)
+{
+    if (sem == nullptr) {
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    tos_use_critical_section();
+    tos_enter_critical_section();
+
+    if (*sem == nullptr) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_NULLPTR;
+    }
+    tos_sem_intenal_t* sem_intenal = *sem;
+
+    // sem is invalid
+    if (!tos_sem_check(sem_intenal)) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_INVALID;
+    }
+
+    // 1 sem is available
+    if (sem_intenal->count > 0) {
+        sem_intenal->count--;
+        tos_trace(TOS_TRACE_SEM_TAKE, tos_trace_obj(sem_intenal));
+        tos_leave_critical_section();
+        return 0;
+    }
+
+    // 2.1 immediately, ISR can not wait
+    if (try_nms == TOS_SEM_WAIT_IMMEDIATE || tos_state.intr_level > 0) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_TIMEOUT;
+    }
+
+    // 2.2 wait sem
+    // add current task to pending list
+    tos_task_tcb_t* current_task = tos_get_current_task();
+    tos_trace(TOS_TRACE_SEM_PEND, tos_trace_obj(sem_intenal));
+    current_task->task_flag &= ~TOS_TASK_FLAG_WAIT_OK;
+    tos_ready_list_remove(current_task);
+    tos_wait_queue_insert(&sem_intenal->pending_list, current_task);
+
+    // add current task into waiting list
+    if (try_nms != TOS_SEM_WAIT_INFINITE) {
+        tos_waiting_list_insert(current_task, try_nms / TOS_TICK_MS);
+    }
+    tos_leave_critical_section();
+
+    tos_schedule();
+
+    // the sem is handed over by give, or timeout
+    if ((current_task->task_flag & TOS_TASK_FLAG_WAIT_OK) == 0) {
+        return TOS_ERR_SEM_TIMEOUT;
+    }
+    tos_trace(TOS_TRACE_SEM_TAKE, tos_trace_obj(sem_intenal));
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @return int
+ * @note ISR safe, schedule is deferred to tos_exit_isr
+ */
+int tos_sem_give(tos_sem_t* sem)
+{
+    if (sem == nullptr) {
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    tos_use_critical_section();
+    tos_enter_critical_section();
+
+    if (*sem == nullptr) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_NULLPTR;
+    }
+    tos_sem_intenal_t* sem_intenal = *sem;
+
+    // sem is invalid
+    if (!tos_sem_check(sem_intenal)) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_INVALID;
+    }
+
+    tos_trace(TOS_TRACE_SEM_GIVE, tos_trace_obj(sem_intenal));
+
+    // no task waits, keep it in count
+    if (tos_wait_queue_empty(&sem_intenal->pending_list)) {
+        if (sem_intenal->count == sem_intenal->max) {
+            tos_leave_critical_section();
+            return TOS_ERR_SEM_OVERFLOW;
+        }
+        sem_intenal->count++;
+        tos_leave_critical_section();
+        return 0;
+    }
+
+    // hand over to the task with highest prio
+    tos_task_tcb_t* hignest_prio_task = tos_wait_queue_first(&sem_intenal->pending_list);
+    tos_wait_queue_remove(hignest_prio_task);
+    tos_waiting_list_remove(hignest_prio_task);
+    hignest_prio_task->task_flag |= TOS_TASK_FLAG_WAIT_OK;
+    tos_ready_list_insert(hignest_prio_task);
+    tos_task_wakeup_stamp(hignest_prio_task);
+
+    tos_leave_critical_section();
+
+    tos_schedule();
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @return int
+ */
+int tos_sem_destroy(tos_sem_t* sem)
+{
+    if (sem == nullptr) {
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    tos_use_critical_section();
+    tos_enter_critical_section();
+
+    if (*sem == nullptr) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_NULLPTR;
+    }
+
+    tos_sem_intenal_t* sem_intenal = *sem;
+
+    if (!tos_sem_check(sem_intenal)) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_INVALID;
+    }
+
+    if (!tos_wait_queue_empty(&sem_intenal->pending_list)) {
+        tos_leave_critical_section();
+        return TOS_ERR_SEM_BLOCKING;
+    }
+
+    sem_intenal->valid_flag = SEM_INVALID_FLAG;
+
+    tos_leave_critical_section();
+
+    if (!sem_intenal->is_static) {
+        tos_free(sem_intenal);
+    }
+
+    *sem = nullptr;
+
+    return 0;
+}
+
+
+/**
+ * @brief init sem in its storage
+ *
+ * @param sem_intenal
+ * @param count
+ * @param attr
+ * @param is_static
+ */
+static void tos_sem_setup(tos_sem_intenal_t* sem_intenal, uint32_t count, const tos_sem_attr_t* attr, bool is_static)
+{
+    sem_intenal->max       = (attr != nullptr && attr->sem_max != 0) ? attr->sem_max : 0xFFFFFFFFu;
+    sem_intenal->count     = (count < sem_intenal->max) ? count : sem_intenal->max;
+    sem_intenal->is_static = is_static;
+    tos_wait_queue_init(&(sem_intenal->pending_list));
+    sem_intenal->valid_flag = SEM_VALID_FLAG;
+}
+
+
+/**
+ * @brief check sem, the one by TOS_SEM_INITIALIZER is setup at its first use
+ *
+ * @param sem_intenal
+ * @return true if valid
+ * @note called in critical section
+ */
+static bool tos_sem_check(tos_sem_intenal_t* sem_intenal)
+{
+    if (sem_intenal->valid_flag == SEM_INITIALIZER_FLAG) {
+        tos_sem_attr_t attr = {.sem_max = sem_intenal->max};
+
+        tos_sem_setup(sem_intenal, sem_intenal->count, &attr, true);
+    }
+
+    return sem_intenal->valid_flag == SEM_VALID_FLAG;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file tos_sem.h
+ * @brief counting semaphore
+ * @note tos_sem_give is ISR safe, the task it wakes up is switched to when the ISR exits
+ */
+
+#ifndef _TOS_SEM_H_
+#define _TOS_SEM_H_
+
+
+#include "tos_core.h"
+#include "tos_types.h"
+
+
+#define TOS_ERR_SEM_NULLPTR    -1
+#define TOS_ERR_SEM_NOFREE     -2
+#define TOS_ERR_SEM_TIMEOUT    -3
+#define TOS_ERR_SEM_OVERFLOW   -4   // give when count reaches the max
+#define TOS_ERR_SEM_BLOCKING   -6   // blocking when destroy
+#define TOS_ERR_SEM_INVALID    -7
+
+#define TOS_SEM_WAIT_INFINITE  0xFFFFFFFFu
+#define TOS_SEM_WAIT_IMMEDIATE 0
+
+
+typedef struct tos_sem_intenal_t* tos_sem_t;
+typedef struct tos_sem_intenal_t  tos_sem_storage_t;   // storage for tos_sem_init_static, see tos_static.h
+
+typedef struct {
+    uint32_t sem_max;   // max count, 0: no limit
+} tos_sem_attr_t;
+
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @param count initial count
+ * @param attr nullptr: no limit of count
+ * @return int
+ */
+int tos_sem_init(tos_sem_t* sem, uint32_t count, const tos_sem_attr_t* attr);
+
+/**
+ * @brief init sem in the storage given by caller, the heap is not used
+ *
+ * @param sem
+ * @param count
+ * @param attr
+ * @param storage
+ * @return int
+ */
+int tos_sem_init_static(tos_sem_t* sem, uint32_t count, const tos_sem_attr_t* attr, tos_sem_storage_t* storage);
+
+/**
+ * @brief take the sem, wait until it's given
+ *
+ * @param sem
+ * @return int
+ */
+int tos_sem_take(tos_sem_t* sem);
+
+/**
+ * @brief take the sem, wait at most try_nms
+ *
+ * @param sem
+ * @param try_nms TOS_SEM_WAIT_IMMEDIATE in ISR
+ * @return int
+ */
+int tos_sem_trytake(tos_sem_t* sem, uint32_t try_nms);
+
+/**
+ * @brief give the sem, the highest prio waiter takes it directly
+ *
+ * @param sem
+ * @return int
+ * @note ISR safe
+ */
+int tos_sem_give(tos_sem_t* sem);
+
+/**
+ * @brief
+ *
+ * @param sem
+ * @return int
+ */
+int tos_sem_destroy(tos_sem_t* sem);
+
+
+#endif
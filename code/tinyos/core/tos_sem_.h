@@ -0,0 +1,27 @@
+/**
+ * @file tos_sem_.h
+ * @brief counting semaphore
+ * @note private, not for user
+ */
+
+#ifndef _TOS_SEM__H_
+#define _TOS_SEM__H_
+
+
+#include "tos_core_.h"
+#include "tos_sem.h"
+
+
+#define SEM_INITIALIZER_FLAG 0xA5A5A5A5u   // valid_flag by TOS_SEM_INITIALIZER, setup at the first use
+
+
+typedef struct tos_sem_intenal_t {
+    uint32_t         valid_flag;
+    uint32_t         count;
+    uint32_t         max;            // sem_max 0 from the attr means no limit and is stored as 0xFFFFFFFF
+    tos_wait_queue_t pending_list;   // tasks waiting for the sem, only when count is 0
+    bool             is_static;      // storage is given by user, not freed by destroy
+} tos_sem_intenal_t;
+
+
+#endif
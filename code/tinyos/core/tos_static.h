@@ -0,0 +1,30 @@
+/**
+ * @file tos_static.h
+ * @brief storage of kernel objects for static creation, no heap is needed
+ * @note the storage types have the layout of kernel objects, their fields are private.
+ *       a mutex, cond, sem or event can be defined by initializer, it's setup at the first use:
+ *           static tos_mutex_storage_t lock_storage = TOS_MUTEX_INITIALIZER;
+ *           static tos_mutex_t         lock         = &lock_storage;
+ */
+
+#ifndef _TOS_STATIC_H_
+#define _TOS_STATIC_H_
+
+
+#include "tos_cond_.h"
+#include "tos_core_.h"
+#include "tos_event_.h"
+#include "tos_mempool_.h"
+#include "tos_msgq_.h"
+#include "tos_mutex_.h"
+#include "tos_sem_.h"
+#include "tos_timer_.h"
+
+
+#define TOS_MUTEX_INITIALIZER  {.valid_flag = MUTEX_INITIALIZER_FLAG}
+#define TOS_COND_INITIALIZER   {.valid_flag = COND_INITIALIZER_FLAG}
+#define TOS_EVENT_INITIALIZER  {.valid_flag = EVENT_INITIALIZER_FLAG}   // no flag is set
+#define TOS_SEM_INITIALIZER(n) {.valid_flag = SEM_INITIALIZER_FLAG, .count = (n)}   // no limit of count
+
+
+#endif
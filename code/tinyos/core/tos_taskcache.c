@@ -0,0 +1,145 @@
+/**
+ * @file tos_taskcache.c
+ * @brief per-task cache of heap blocks
+ * @note a block freed by a task is kept in the list of its size class in the tcb, and given to a later alloc of the
+ *       same class by the task, no critical section is needed as no one else touches the lists. a block goes to the
+ *       cache of the task frees it, not the one allocated it. ISRs always use the heap
+ */
+
+#include "tos_config.h"
+#include "tos_core_.h"
+#include "tos_mem.h"
+#include "tos_taskcache_.h"
+#include "util_heap.h"
+
+
+#if TOS_TASK_CACHE_ENABLE
+
+
+static tos_task_cache_t* tos_task_cache_current(void);
+static void              tos_task_cache_release(tos_task_cache_t* cache);
+
+
+void tos_task_cache_init(tos_task_cache_t* cache)
+{
+    for (uint32_t cls = 0; cls < TOS_TASK_CACHE_CLASS_NUM; cls++) {
+        cache->free_list[cls] = nullptr;
+    }
+    cache->bytes     = 0;
+    cache->hit_cnt   = 0;
+    cache->miss_cnt  = 0;
+    cache->flush_cnt = 0;
+}
+
+
+void* tos_task_cache_alloc(tos_size_t size)
+{
+    tos_task_cache_t* cache = tos_task_cache_current();
+    uint32_t          cls   = (size + TOS_TASK_CACHE_CLASS_SIZE - 1) / TOS_TASK_CACHE_CLASS_SIZE - 1;
+    void*             blk;
+
+    if (cache == nullptr) {
+        return tos_heap_malloc(size);
+    }
+
+    blk = cache->free_list[cls];
+    if (blk != nullptr) {
+        cache->free_list[cls] = *(void**)blk;
+        cache->bytes -= (cls + 1) * TOS_TASK_CACHE_CLASS_SIZE;
+        cache->hit_cnt++;
+        return blk;
+    }
+
+    // large enough for any size of the class, so it's reusable when cached
+    cache->miss_cnt++;
+    blk = tos_heap_malloc((cls + 1) * TOS_TASK_CACHE_CLASS_SIZE);
+    if (blk == nullptr && cache->bytes != 0) {
+        // the heap may be short of what is cached. caches of other tasks are not touched, they are used without lock
+        tos_task_cache_release(cache);
+        blk = tos_heap_malloc((cls + 1) * TOS_TASK_CACHE_CLASS_SIZE);
+    }
+
+    return blk;
+}
+
+
+bool tos_task_cache_free(void* ptr)
+{
+    tos_task_cache_t* cache = tos_task_cache_current();
+    util_size_t       size;
+    uint32_t          cls;
+
+    if (cache == nullptr || ptr == nullptr) {
+        return false;
+    }
+
+    // the head of a used block is only changed by its owner, it's safe to read without the critical section
+    size = util_usable_size(ptr);
+    if (size < TOS_TASK_CACHE_CLASS_SIZE || size >= TOS_TASK_CACHE_SIZE_MAX + TOS_TASK_CACHE_CLASS_SIZE) {
+        return false;
+    }
+
+    // the class all sizes of which it can hold
+    cls = size / TOS_TASK_CACHE_CLASS_SIZE - 1;
+    if (cache->bytes + (cls + 1) * TOS_TASK_CACHE_CLASS_SIZE > TOS_TASK_CACHE_BYTES_MAX) {
+        tos_task_cache_release(cache);
+    }
+
+    *(void**)ptr          = cache->free_list[cls];
+    cache->free_list[cls] = ptr;
+    cache->bytes += (cls + 1) * TOS_TASK_CACHE_CLASS_SIZE;
+
+    return true;
+}
+
+
+void tos_task_cache_flush(struct tos_task_tcb_t* tcb)
+{
+    if (tcb != nullptr) {
+        tos_task_cache_release(&tcb->task_cache);
+    }
+}
+
+
+/**
+ * @brief the cache of current task
+ *
+ * @return tos_task_cache_t* nullptr if called by ISR or no task is running
+ */
+static tos_task_cache_t* tos_task_cache_current(void)
+{
+    tos_task_tcb_t* tcb = tos_get_current_task();
+
+    if (tcb == nullptr || tos_state.intr_level > 0) {
+        return nullptr;
+    }
+
+    return &tcb->task_cache;
+}
+
+
+/**
+ * @brief free all blocks cached to the heap
+ *
+ * @param cache
+ * @note a critical section for each block, not one for all, the irq latency is not longer than without the cache
+ */
+static void tos_task_cache_release(tos_task_cache_t* cache)
+{
+    for (uint32_t cls = 0; cls < TOS_TASK_CACHE_CLASS_NUM; cls++) {
+        void* blk = cache->free_list[cls];
+
+        cache->free_list[cls] = nullptr;
+        while (blk != nullptr) {
+            void* next = *(void**)blk;
+
+            tos_heap_free(blk);
+            blk = next;
+        }
+    }
+    cache->bytes = 0;
+    cache->flush_cnt++;
+}
+
+
+#endif
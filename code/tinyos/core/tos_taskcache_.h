@@ -0,0 +1,64 @@
+/**
+ * @file tos_taskcache_.h
+ * @brief per-task cache of heap blocks
+ * @note private, not for user
+ */
+
+#ifndef _TOS_TASKCACHE__H_
+#define _TOS_TASKCACHE__H_
+
+
+#include "tos_config.h"
+#include "tos_types.h"
+
+
+#define TOS_TASK_CACHE_CLASS_SIZE (TOS_TASK_CACHE_SIZE_MAX / TOS_TASK_CACHE_CLASS_NUM)
+
+
+// in tcb, only touched by the task itself, and by tos_task_delete when it's not running
+typedef struct {
+    void*    free_list[TOS_TASK_CACHE_CLASS_NUM];   // blocks of class n hold (n+1) * TOS_TASK_CACHE_CLASS_SIZE at least,
+                                                    // linked by their first word
+    uint32_t bytes;                                 // usable bytes of all blocks cached
+    uint32_t hit_cnt;                               // allocs served by the cache
+    uint32_t miss_cnt;                              // allocs went to the heap
+    uint32_t flush_cnt;                             // times the cache was given back to the heap
+} tos_task_cache_t;
+
+
+struct tos_task_tcb_t;
+
+/**
+ * @brief
+ *
+ * @param cache
+ */
+void tos_task_cache_init(tos_task_cache_t* cache);
+
+/**
+ * @brief get a block from the cache of current task, or from the heap with size rounded up to its class
+ *
+ * @param size not larger than TOS_TASK_CACHE_SIZE_MAX
+ * @return void*
+ * @note the heap is used directly if called by ISR or before tos_start
+ */
+void* tos_task_cache_alloc(tos_size_t size);
+
+/**
+ * @brief put a heap block into the cache of current task
+ *
+ * @param ptr
+ * @return true cached
+ * @return false called by ISR, or the block is not of the heap or too large, it should be freed to the heap
+ */
+bool tos_task_cache_free(void* ptr);
+
+/**
+ * @brief give all blocks cached by the task back to the heap, in one critical section
+ *
+ * @param tcb the current task, or a task not running
+ */
+void tos_task_cache_flush(struct tos_task_tcb_t* tcb);
+
+
+#endif
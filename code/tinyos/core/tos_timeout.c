@@ -0,0 +1,243 @@
+/**
+ * @file tos_timeout.c
+ * @brief kernel timeouts on a hierarchical timing wheel
+ * @note level n has 32 slots of 32^n ticks each. a timeout is put into the lowest level which covers it,
+ *       and moved down (cascaded) when the lower level wraps, until it expires from level 0.
+ *       timeouts longer than the wheel are parked at the farthest slot and re-inserted when cascaded
+ */
+
+#include "tos_config.h"
+#include "tos_cpu.h"
+#include "tos_timeout_.h"
+#include "util_misc.h"
+#include "util_queue.h"
+
+
+#define get_timeout_by_link(node) util_containerof(tos_timeout_t, link, node)
+
+
+static void     tos_wheel_insert(tos_timeout_t* timeout);
+static void     tos_wheel_remove(tos_timeout_t* timeout);
+static void     tos_wheel_cascade(uint32_t level, uint32_t index);
+static void     tos_wheel_tick(void);
+static uint32_t tos_wheel_ctz(uint32_t x);
+
+
+static uint32_t          tos_wheel_now;                                     // ticks processed by the wheel
+static uint32_t          tos_wheel_map[TOS_TIMEOUT_WHEEL_LEVELS];           // bit n is set if slot n is not empty
+static util_queue_node_t tos_wheel_slots[TOS_TIMEOUT_WHEEL_LEVELS][TOS_WHEEL_SLOT_NUM];
+
+
+void tos_timeout_wheel_init(void)
+{
+    tos_wheel_now = 0;
+    for (uint32_t level = 0; level < TOS_TIMEOUT_WHEEL_LEVELS; level++) {
+        tos_wheel_map[level] = 0;
+        for (uint32_t index = 0; index < TOS_WHEEL_SLOT_NUM; index++) {
+            util_queue_init(&tos_wheel_slots[level][index]);
+        }
+    }
+}
+
+
+void tos_timeout_arm(tos_timeout_t* timeout, uint32_t ticks)
+{
+    tos_timeout_arm_at(timeout, tos_wheel_now + util_min2(util_max2(ticks, 1u), TOS_TIMEOUT_TICKS_MAX));
+}
+
+
+void tos_timeout_arm_at(tos_timeout_t* timeout, uint32_t expires)
+{
+    tos_wheel_remove(timeout);
+
+    // the slot of current tick has been processed
+    if ((int32_t)(expires - tos_wheel_now) <= 0) {
+        expires = tos_wheel_now + 1;
+    }
+    timeout->expires = expires;
+    tos_wheel_insert(timeout);
+}
+
+
+void tos_timeout_cancel(tos_timeout_t* timeout)
+{
+    tos_wheel_remove(timeout);
+}
+
+
+void tos_timeout_advance(uint32_t ticks)
+{
+    while (ticks > 1) {
+        // nothing expires or cascades before next, jump over the empty ticks
+        uint32_t skip = util_min2(ticks, tos_timeout_next_ticks()) - 1;
+        tos_wheel_now += skip;
+        ticks -= skip;
+        if (ticks > 0) {
+            tos_wheel_tick();
+            ticks--;
+        }
+    }
+    if (ticks > 0) {
+        tos_wheel_tick();
+    }
+}
+
+
+uint32_t tos_timeout_next_ticks(void)
+{
+    uint32_t next = TOS_TIME_WAIT_INFINITY;
+
+    for (uint32_t level = 0; level < TOS_TIMEOUT_WHEEL_LEVELS; level++) {
+        uint32_t map = tos_wheel_map[level];
+        if (map == 0) {
+            continue;
+        }
+
+        // rotate the map, bit 0 is the slot after the current one, the current slot is the last
+        uint32_t shift = TOS_WHEEL_SLOT_BITS * level;
+        uint32_t base  = tos_wheel_now >> shift;
+        uint32_t rot   = (base + 1) & TOS_WHEEL_SLOT_MASK;
+        if (rot != 0) {
+            map = (map >> rot) | (map << (TOS_WHEEL_SLOT_NUM - rot));
+        }
+
+        // the slot is processed when the wheel reaches its start
+        uint32_t ticks = ((base + tos_wheel_ctz(map) + 1) << shift) - tos_wheel_now;
+        next           = util_min2(next, ticks);
+    }
+
+    return next;
+}
+
+
+/**
+ * @brief put timeout into the slot covers it
+ *
+ * @param timeout not armed
+ */
+static void tos_wheel_insert(tos_timeout_t* timeout)
+{
+    uint32_t expires = timeout->expires;
+    uint32_t delta   = expires - tos_wheel_now;
+    uint32_t level   = 0;
+
+    if ((int32_t)delta < 0) {
+        // cascaded at the expiry tick, the current slot of level 0 is processed right after cascade
+        delta   = 0;
+        expires = tos_wheel_now;
+    } else if (delta >= TOS_WHEEL_RANGE) {
+        // longer than the wheel, park at the farthest slot
+        delta   = TOS_WHEEL_RANGE - 1;
+        expires = tos_wheel_now + delta;
+    }
+
+    while (level < TOS_TIMEOUT_WHEEL_LEVELS - 1 && delta >= (1u << (TOS_WHEEL_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    uint32_t index = (expires >> (TOS_WHEEL_SLOT_BITS * level)) & TOS_WHEEL_SLOT_MASK;
+
+    util_queue_insert(&tos_wheel_slots[level][index], &timeout->link);
+    tos_wheel_map[level] |= 1u << index;
+    timeout->slot = (uint16_t)(level * TOS_WHEEL_SLOT_NUM + index);
+}
+
+
+/**
+ * @brief remove timeout from its slot if it's armed
+ *
+ * @param timeout
+ */
+static void tos_wheel_remove(tos_timeout_t* timeout)
+{
+    if (!tos_timeout_armed(timeout)) {
+        return;
+    }
+
+    uint32_t level = timeout->slot >> TOS_WHEEL_SLOT_BITS;
+    uint32_t index = timeout->slot & TOS_WHEEL_SLOT_MASK;
+
+    util_queue_remove(&timeout->link);
+    util_queue_init(&timeout->link);
+    if (util_queue_empty(&tos_wheel_slots[level][index])) {
+        tos_wheel_map[level] &= ~(1u << index);
+    }
+}
+
+
+/**
+ * @brief move timeouts of the slot to lower levels
+ *
+ * @param level
+ * @param index
+ */
+static void tos_wheel_cascade(uint32_t level, uint32_t index)
+{
+    util_queue_node_t* slot = &tos_wheel_slots[level][index];
+    util_queue_node_t  list;
+
+    if (util_queue_empty(slot)) {
+        return;
+    }
+
+    // take the whole slot, timeouts parked at the farthest slot may come back to this level
+    list.next       = slot->next;
+    list.prev       = slot->prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    util_queue_init(slot);
+    tos_wheel_map[level] &= ~(1u << index);
+
+    while (!util_queue_empty(&list)) {
+        tos_timeout_t* timeout = get_timeout_by_link(list.next);
+        util_queue_remove(&timeout->link);
+        tos_wheel_insert(timeout);
+    }
+}
+
+
+/**
+ * @brief process one tick, cascade higher levels when level 0 wraps, and expire the current slot
+ *
+ */
+static void tos_wheel_tick(void)
+{
+    uint32_t index = ++tos_wheel_now & TOS_WHEEL_SLOT_MASK;
+
+    if (index == 0) {
+        for (uint32_t level = 1; level < TOS_TIMEOUT_WHEEL_LEVELS; level++) {
+            uint32_t level_index = (tos_wheel_now >> (TOS_WHEEL_SLOT_BITS * level)) & TOS_WHEEL_SLOT_MASK;
+            tos_wheel_cascade(level, level_index);
+            if (level_index != 0) {
+                break;
+            }
+        }
+    }
+
+    util_queue_node_t* slot = &tos_wheel_slots[0][index];
+
+    while (!util_queue_empty(slot)) {
+        tos_timeout_t* timeout = get_timeout_by_link(slot->next);
+        util_queue_remove(&timeout->link);
+        util_queue_init(&timeout->link);
+
+        if ((int32_t)(timeout->expires - tos_wheel_now) > 0) {
+            tos_wheel_insert(timeout);   // not yet, parked one
+        } else {
+            timeout->proc(timeout);   // may re-arm itself, never into this slot
+        }
+    }
+    tos_wheel_map[0] &= ~(1u << index);
+}
+
+
+/**
+ * @brief count trailing zeros
+ *
+ * @param x should not be 0
+ * @return uint32_t
+ */
+static uint32_t tos_wheel_ctz(uint32_t x)
+{
+    return 31 - tos_cpu_clz(x & (~x + 1));
+}
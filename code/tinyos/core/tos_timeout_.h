@@ -0,0 +1,101 @@
+/**
+ * @file tos_timeout_.h
+ * @brief kernel timeouts on a hierarchical timing wheel
+ * @note private, not for user
+ */
+
+#ifndef _TOS_TIMEOUT__H_
+#define _TOS_TIMEOUT__H_
+
+
+#include "tos_config.h"
+#include "tos_types.h"
+#include "util_queue.h"
+
+
+#define TOS_WHEEL_SLOT_BITS   5
+#define TOS_WHEEL_SLOT_NUM    (1u << TOS_WHEEL_SLOT_BITS)   // slots per level, one bit each in the slot map
+#define TOS_WHEEL_SLOT_MASK   (TOS_WHEEL_SLOT_NUM - 1)
+#define TOS_WHEEL_RANGE       (1u << (TOS_WHEEL_SLOT_BITS * TOS_TIMEOUT_WHEEL_LEVELS))   // ticks covered by wheel
+#define TOS_TIMEOUT_TICKS_MAX 0x7FFFFFFFu   // longer ones are clamped, expires is compared with now as signed
+
+#if TOS_TIMEOUT_WHEEL_LEVELS < 1 || TOS_TIMEOUT_WHEEL_LEVELS > 6
+#error "TOS_TIMEOUT_WHEEL_LEVELS should be 1..6"
+#endif
+
+
+struct tos_timeout_t;
+
+typedef void (*tos_timeout_proc_t)(struct tos_timeout_t* timeout);
+
+typedef struct tos_timeout_t {
+    util_queue_node_t  link;      // link to slot of the wheel, empty if not armed
+    uint32_t           expires;   // absolute tick
+    uint16_t           slot;      // level * TOS_WHEEL_SLOT_NUM + index of the slot
+    tos_timeout_proc_t proc;      // called in critical section when expired
+} tos_timeout_t;
+
+
+static inline void tos_timeout_init(tos_timeout_t* timeout, tos_timeout_proc_t proc)
+{
+    util_queue_init(&timeout->link);
+    timeout->expires = 0;
+    timeout->slot    = 0;
+    timeout->proc    = proc;
+}
+
+static inline bool tos_timeout_armed(const tos_timeout_t* timeout)
+{
+    return !util_queue_empty(&timeout->link);
+}
+
+/**
+ * @brief init the wheel
+ *
+ */
+void tos_timeout_wheel_init(void);
+
+/**
+ * @brief arm the timeout, expire after ticks, re-arm if it's armed
+ *
+ * @param timeout
+ * @param ticks at least 1, at most TOS_TIMEOUT_TICKS_MAX
+ * @note called in critical section, O(1)
+ */
+void tos_timeout_arm(tos_timeout_t* timeout, uint32_t ticks);
+
+/**
+ * @brief arm the timeout, expire at the absolute tick, or at next tick if it's passed
+ *
+ * @param timeout
+ * @param expires at most TOS_TIMEOUT_TICKS_MAX after now
+ * @note called in critical section, O(1)
+ */
+void tos_timeout_arm_at(tos_timeout_t* timeout, uint32_t expires);
+
+/**
+ * @brief cancel the timeout, nothing to do if it's not armed
+ *
+ * @param timeout
+ * @note called in critical section, O(1)
+ */
+void tos_timeout_cancel(tos_timeout_t* timeout);
+
+/**
+ * @brief advance the wheel, call proc of expired timeouts
+ *
+ * @param ticks
+ * @note called in critical section, amortised O(1) per tick, empty ticks are skipped when ticks > 1
+ */
+void tos_timeout_advance(uint32_t ticks);
+
+/**
+ * @brief ticks to the first expiry, or to the cascade of the first slot of higher levels
+ *
+ * @return uint32_t lower bound of ticks to the first expiry, TOS_TIME_WAIT_INFINITY if nothing armed
+ * @note called in critical section, O(levels)
+ */
+uint32_t tos_timeout_next_ticks(void);
+
+
+#endif
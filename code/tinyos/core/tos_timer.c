@@ -0,0 +1,342 @@
+/**
+ * @file tos_timer.c
+ * @brief software timer
+ * @note active timers are armed on the timing wheel of kernel timeouts, expired timers are handed to
+ *       the timer service task, which runs the callbacks
+ */
+
+#include "tos_timer.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_mem.h"
+#include "tos_timeout_.h"
+#include "tos_timer_.h"
+#include "util_misc.h"
+#include "util_queue.h"
+
+#define TIMER_VALID_FLAG   0x5A5A5A5A
+#define TIMER_INVALID_FLAG 0xFFFFFFFF
+
+
+#define get_timer_by_expired_link(link) util_containerof(tos_timer_intenal_t, expired_link, link)
+
+
+static void tos_timer_task_proc(void* args);
+static void tos_timer_timeout_proc(tos_timeout_t* timeout);
+static int  tos_timer_get(tos_timer_t* timer, tos_timer_intenal_t** timer_intenal);
+static int  tos_timer_check_attr(const tos_timer_attr_t* attr);
+static void tos_timer_setup(tos_timer_intenal_t* timer_intenal, const tos_timer_attr_t* attr, bool is_static);
+
+
+static util_queue_node_t  tos_timer_expired_list;   // expired timers, callbacks to run
+static tos_task_t         tos_timer_task;           // timer service task
+static tos_task_storage_t tos_timer_task_tcb;       // timer task is static, the kernel never uses the heap
+static bool               tos_timer_task_blocked;   // timer service task waits for expired timers
+static tos_stack_t        tos_timer_task_stack[TOS_TIMER_TASK_STACK_SIZE / sizeof(tos_stack_t)];
+
+
+bool tos_timer_init(void)
+{
+    tos_task_attr_t task_attr;
+
+    util_queue_init(&tos_timer_expired_list);
+    tos_timer_task_blocked = false;
+
+    task_attr.task_name       = "timer";
+    task_attr.task_wait_time  = 0;
+    task_attr.task_time_slice = 0;
+    task_attr.task_prio       = TOS_TIMER_TASK_PRIO;
+    task_attr.task_stack_size = TOS_TIMER_TASK_STACK_SIZE;
+    task_attr.task_stack      = tos_timer_task_stack;
+
+    tos_timer_task = tos_task_create_static(tos_timer_task_proc, nullptr, &task_attr, &tos_timer_task_tcb);
+
+    return tos_timer_task != nullptr;
+}
+
+
+/**
+ * @brief
+ *
+ * @param timer
+ * @param attr
+ * @return int
+ */
+int tos_timer_create(tos_timer_t* timer, const tos_timer_attr_t* attr)
+{
+    if (timer == nullptr) {
+        return TOS_ERR_TIMER_NULLPTR;
+    }
+
+    int ret = tos_timer_check_attr(attr);
+    if (ret != 0) {
+        *timer = nullptr;
+        return ret;
+    }
+
+    // get a free timer
+    tos_timer_intenal_t* timer_intenal = tos_malloc(sizeof(tos_timer_intenal_t));
+    if (timer_intenal == nullptr) {
+        *timer = nullptr;
+        return TOS_ERR_TIMER_NOFREE;
+    }
+
+    *timer = timer_intenal;
+    tos_timer_setup(timer_intenal, attr, false);
+
+    return 0;
+}
+
+
+/**
+ * @brief create timer in the storage given by caller, the heap is not used
+ *
+ * @param timer
+ * @param attr
+ * @param storage static or global storage, alive until the timer is destroyed
+ * @return int
+ */
+int tos_timer_create_static(tos_timer_t* timer, const tos_timer_attr_t* attr, tos_timer_storage_t* storage)
+{
+    if (timer == nullptr || storage == nullptr) {
+        return TOS_ERR_TIMER_NULLPTR;
+    }
+
+    int ret = tos_timer_check_attr(attr);
+    if (ret != 0) {
+        *timer = nullptr;
+        return ret;
+    }
+
+    *timer = storage;
+    tos_timer_setup(storage, attr, true);
+
+    return 0;
+}
+
+
+/**
+ * @brief start the timer, restart it if it's active
+ *
+ * @param timer
+ * @return int
+ * @note ISR safe
+ */
+int tos_timer_start(tos_timer_t* timer)
+{
+    tos_timer_intenal_t* timer_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_timer_get(timer, &timer_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    tos_timeout_arm(&timer_intenal->timeout, timer_intenal->ticks);
+
+    tos_leave_critical_section();
+
+    return 0;
+}
+
+
+/**
+ * @brief stop the timer, the expired callback not run yet is dropped
+ *
+ * @param timer
+ * @return int
+ * @note ISR safe
+ */
+int tos_timer_stop(tos_timer_t* timer)
+{
+    tos_timer_intenal_t* timer_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_timer_get(timer, &timer_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    tos_timeout_cancel(&timer_intenal->timeout);
+    util_queue_remove(&timer_intenal->expired_link);
+    util_queue_init(&timer_intenal->expired_link);
+
+    tos_leave_critical_section();
+
+    return 0;
+}
+
+
+/**
+ * @brief restart the timer from now, whether it's active or not
+ *
+ * @param timer
+ * @return int
+ * @note ISR safe
+ */
+int tos_timer_reset(tos_timer_t* timer)
+{
+    return tos_timer_start(timer);
+}
+
+
+/**
+ * @brief
+ *
+ * @param timer
+ * @return int
+ */
+int tos_timer_destroy(tos_timer_t* timer)
+{
+    tos_timer_intenal_t* timer_intenal;
+    tos_use_critical_section();
+
+    tos_enter_critical_section();
+
+    int ret = tos_timer_get(timer, &timer_intenal);
+    if (ret != 0) {
+        tos_leave_critical_section();
+        return ret;
+    }
+
+    tos_timeout_cancel(&timer_intenal->timeout);
+    util_queue_remove(&timer_intenal->expired_link);
+    timer_intenal->valid_flag = TIMER_INVALID_FLAG;
+
+    tos_leave_critical_section();
+
+    if (!timer_intenal->is_static) {
+        tos_free(timer_intenal);
+    }
+
+    *timer = nullptr;
+
+    return 0;
+}
+
+
+/**
+ * @brief timer service task, run callbacks of expired timers
+ *
+ * @param args
+ */
+static void tos_timer_task_proc(void* args)
+{
+    tos_use_critical_section();
+
+    while (true) {
+        tos_enter_critical_section();
+
+        while (!util_queue_empty(&tos_timer_expired_list)) {
+            tos_timer_intenal_t* timer_intenal = get_timer_by_expired_link(tos_timer_expired_list.next);
+            tos_timer_proc_t     proc          = timer_intenal->proc;
+            void*                arg           = timer_intenal->arg;
+
+            util_queue_remove(&timer_intenal->expired_link);
+            util_queue_init(&timer_intenal->expired_link);
+
+            // the timer may be stopped or restarted by the callback
+            tos_leave_critical_section();
+            proc(arg);
+            tos_enter_critical_section();
+        }
+
+        // nothing to do, block until timers expire
+        tos_ready_list_remove(tos_timer_task);
+        tos_timer_task->task_state = TOS_TASK_STATE_PENDING;
+        tos_timer_task_blocked     = true;
+
+        tos_leave_critical_section();
+
+        tos_schedule();
+    }
+}
+
+
+/**
+ * @brief hand the expired timer to the timer service task
+ *
+ * @param timeout
+ * @note called in critical section, by tick or tickless idle
+ */
+static void tos_timer_timeout_proc(tos_timeout_t* timeout)
+{
+    tos_timer_intenal_t* timer_intenal = util_containerof(tos_timer_intenal_t, timeout, timeout);
+
+    if (util_queue_empty(&timer_intenal->expired_link)) {
+        util_queue_insert(&tos_timer_expired_list, &timer_intenal->expired_link);
+    } else {
+        timer_intenal->overrun_cnt++;
+    }
+
+    // re-arm from the expiry time, not from the callback, so the period does not drift
+    if (timer_intenal->mode == TOS_TIMER_PERIODIC) {
+        tos_timeout_arm_at(&timer_intenal->timeout, timeout->expires + timer_intenal->ticks);
+    }
+
+    // wakeup timer service task
+    if (tos_timer_task_blocked) {
+        tos_timer_task_blocked = false;
+        tos_ready_list_insert(tos_timer_task);
+        tos_task_wakeup_stamp(tos_timer_task);
+    }
+}
+
+
+/**
+ * @brief check the timer handle
+ *
+ * @param timer
+ * @param timer_intenal
+ * @return int
+ * @note called in critical section
+ */
+static int tos_timer_get(tos_timer_t* timer, tos_timer_intenal_t** timer_intenal)
+{
+    if (timer == nullptr || *timer == nullptr) {
+        return TOS_ERR_TIMER_NULLPTR;
+    }
+
+    if ((*timer)->valid_flag != TIMER_VALID_FLAG) {
+        return TOS_ERR_TIMER_INVALID;
+    }
+
+    *timer_intenal = *timer;
+    return 0;
+}
+
+
+static int tos_timer_check_attr(const tos_timer_attr_t* attr)
+{
+    if (attr == nullptr || attr->timer_proc == nullptr) {
+        return TOS_ERR_TIMER_NULLPTR;
+    }
+
+    if (attr->timer_nms < TOS_TICK_MS
+        || (attr->timer_mode != TOS_TIMER_ONESHOT && attr->timer_mode != TOS_TIMER_PERIODIC)) {
+        return TOS_ERR_TIMER_PARAM;
+    }
+
+    return 0;
+}
+
+
+static void tos_timer_setup(tos_timer_intenal_t* timer_intenal, const tos_timer_attr_t* attr, bool is_static)
+{
+    timer_intenal->valid_flag  = TIMER_VALID_FLAG;
+    timer_intenal->proc        = attr->timer_proc;
+    timer_intenal->arg         = attr->timer_arg;
+    timer_intenal->ticks       = util_min2(attr->timer_nms / TOS_TICK_MS, TOS_TIMEOUT_TICKS_MAX);
+    timer_intenal->overrun_cnt = 0;
+    timer_intenal->mode        = attr->timer_mode;
+    timer_intenal->is_static   = is_static;
+    tos_timeout_init(&timer_intenal->timeout, tos_timer_timeout_proc);
+    util_queue_init(&timer_intenal->expired_link);
+}
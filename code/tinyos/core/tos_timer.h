@@ -0,0 +1,44 @@
+/**
+ * @file tos_timer.h
+ * @brief software timer
+ * @note callbacks run in the timer service task, they should not block
+ */
+
+#ifndef _TOS_TIMER_H_
+#define _TOS_TIMER_H_
+
+
+#include "tos_types.h"
+
+
+#define TOS_ERR_TIMER_NULLPTR -1
+#define TOS_ERR_TIMER_NOFREE  -2
+#define TOS_ERR_TIMER_PARAM   -3
+#define TOS_ERR_TIMER_INVALID -7
+
+#define TOS_TIMER_ONESHOT     0   // expire once after timer_nms
+#define TOS_TIMER_PERIODIC    1   // expire every timer_nms until stopped
+
+
+typedef struct tos_timer_intenal_t* tos_timer_t;
+typedef struct tos_timer_intenal_t  tos_timer_storage_t;   // storage for tos_timer_create_static, see tos_static.h
+
+typedef void (*tos_timer_proc_t)(void* arg);
+
+typedef struct {
+    tos_timer_proc_t timer_proc;
+    void*            timer_arg;
+    uint32_t         timer_nms;    // delay of one-shot timer, or period of periodic timer
+    uint8_t          timer_mode;   // TOS_TIMER_ONESHOT or TOS_TIMER_PERIODIC
+} tos_timer_attr_t;
+
+
+int tos_timer_create(tos_timer_t* timer, const tos_timer_attr_t* attr);
+int tos_timer_create_static(tos_timer_t* timer, const tos_timer_attr_t* attr, tos_timer_storage_t* storage);
+int tos_timer_start(tos_timer_t* timer);
+int tos_timer_stop(tos_timer_t* timer);
+int tos_timer_reset(tos_timer_t* timer);
+int tos_timer_destroy(tos_timer_t* timer);
+
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file tos_timer_.h
+ * @brief software timer
+ * @note private, not for user
+ */
+
+#ifndef _TOS_TIMER__H_
+#define _TOS_TIMER__H_
+
+
+#include "tos_timeout_.h"
+#include "tos_timer.h"
+#include "tos_types.h"
+#include "util_queue.h"
+
+
+typedef struct tos_timer_intenal_t {
+    uint32_t          valid_flag;
+    tos_timer_proc_t  proc;
+    void*             arg;
+    uint32_t          ticks;          // delay or period
+    uint32_t          overrun_cnt;    // periodic timer expired again before its callback runs
+    uint8_t           mode;
+    bool              is_static;      // storage is given by user, not freed by destroy
+    tos_timeout_t     timeout;        // armed when the timer is active
+    util_queue_node_t expired_link;   // link to expired timer list
+} tos_timer_intenal_t;
+
+
+/**
+ * @brief init timer lists, create the timer service task
+ *
+ * @return true
+ * @return false
+ */
+bool tos_timer_init(void);
+
+
+#endif
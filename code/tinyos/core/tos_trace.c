@@ -0,0 +1,96 @@
+/**
+ * @file tos_trace.c
+ * @brief kernel event trace
+ *
+ */
+
+#include "tos_trace.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_trace_.h"
+#include "util_log.h"
+#include "util_queue.h"
+
+
+#if TOS_TRACE_ENABLE
+
+tos_trace_ring_t tos_trace_ring = {.mask = TOS_TRACE_MASK_DEFAULT, .head = 0};
+
+
+void tos_trace_start(uint32_t mask)
+{
+    tos_trace_ring.mask = mask & TOS_TRACE_MASK_ALL;
+}
+
+
+void tos_trace_stop(void)
+{
+    tos_trace_ring.mask = 0;
+}
+
+
+void tos_trace_clear(void)
+{
+    uint32_t mask = tos_trace_ring.mask;
+
+    tos_trace_ring.mask = 0;
+    tos_trace_ring.head = 0;
+    tos_trace_ring.mask = mask;
+}
+
+
+void tos_trace_dump(void)
+{
+    uint32_t  mask = tos_trace_ring.mask;
+    uintptr_t head, tail;
+    tos_use_critical_section();
+
+    tos_trace_ring.mask = 0;
+
+    head = tos_trace_ring.head;
+    tail = (head > TOS_TRACE_BUF_SIZE) ? head - TOS_TRACE_BUF_SIZE : 0;
+
+    util_printk("tos-trace %d %u %u\n", TOS_TRACE_VERSION, TOS_CPU_CYCLES_HZ, (uint32_t)(head - tail));
+
+    // names of tasks, records only have the id
+    tos_enter_critical_section();
+    util_queue_foreach(link, &tos_state.all_task_list)
+    {
+        tos_task_tcb_t* tcb = get_task_by_all_link(link);
+        util_printk("task %u %u %s\n", tcb->task_id, tcb->task_base_prio, tcb->task_name);
+    }
+    tos_leave_critical_section();
+
+    for (; tail != head; tail++) {
+        tos_trace_record_t* record = &tos_trace_ring.records[tail & (TOS_TRACE_BUF_SIZE - 1)];
+        util_printk("%08x %02x %02x %04x\n", record->cycles, record->event, record->task, record->arg);
+    }
+    util_printk("end\n");
+
+    tos_trace_ring.mask = mask;
+}
+
+#else
+
+void tos_trace_start(uint32_t mask)
+{
+}
+
+
+void tos_trace_stop(void)
+{
+}
+
+
+void tos_trace_clear(void)
+{
+}
+
+
+void tos_trace_dump(void)
+{
+    util_printk("trace is disabled, set TOS_TRACE_ENABLE\n");
+}
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file tos_trace.h
+ * @brief kernel event trace
+ * @note events are recorded into a ring with cycle timestamps, and dumped as text, see
+ *       code/tools/tos_trace2json.c to convert a dump to chrome/perfetto trace json
+ */
+
+#ifndef _TOS_TRACE_H_
+#define _TOS_TRACE_H_
+
+
+#include "tos_types.h"
+
+
+#define TOS_TRACE_VERSION  1
+#define TOS_TRACE_NO_TASK  0xFF   // task of events before tos start
+#define TOS_TRACE_MASK_ALL ((1u << TOS_TRACE_EVENT_NUM) - 1)
+
+#define tos_trace_bit(event) (1u << (event))
+
+
+typedef enum {
+    TOS_TRACE_SWITCH = 0,       // task: switched out, arg: id of task switched in
+    TOS_TRACE_ISR_ENTER,        // arg: intr level after enter
+    TOS_TRACE_ISR_EXIT,         // arg: intr level after exit
+    TOS_TRACE_TICK,             // arg: low 16 bits of sys ticks
+    TOS_TRACE_TASK_CREATE,      // arg: id of the new task
+    TOS_TRACE_TASK_DELETE,      // arg: id of the deleted task
+    TOS_TRACE_MUTEX_LOCK,       // arg: object, see tos_trace_obj
+    TOS_TRACE_MUTEX_CONTEND,    // arg: object, the task blocks
+    TOS_TRACE_MUTEX_UNLOCK,     // arg: object
+    TOS_TRACE_COND_WAIT,        // arg: object, the task blocks
+    TOS_TRACE_COND_SIGNAL,      // arg: object
+    TOS_TRACE_COND_BROADCAST,   // arg: object
+    TOS_TRACE_SEM_TAKE,         // arg: object
+    TOS_TRACE_SEM_PEND,         // arg: object, the task blocks
+    TOS_TRACE_SEM_GIVE,         // arg: object
+    TOS_TRACE_MSGQ_SEND,        // arg: object, a message is committed
+    TOS_TRACE_MSGQ_RECV,        // arg: object, a message is acquired
+    TOS_TRACE_MSGQ_PEND,        // arg: object, the task blocks
+    TOS_TRACE_EVENT_SET,        // arg: object, flags of the event object are set
+    TOS_TRACE_EVENT_PEND,       // arg: object, the task blocks
+    TOS_TRACE_NOTIFY,           // arg: id of the task notified
+    TOS_TRACE_EVENT_NUM,
+} tos_trace_event_t;
+
+#define TOS_TRACE_EVENT_NAMES                                                                                          \
+    "switch", "isr_enter", "isr_exit", "tick", "task_create", "task_delete", "mutex_lock", "mutex_contend",            \
+        "mutex_unlock", "cond_wait", "cond_signal", "cond_broadcast", "sem_take", "sem_pend", "sem_give",              \
+        "msgq_send", "msgq_recv", "msgq_pend", "event_set", "event_pend", "notify"
+
+// 8 bytes a record
+typedef struct {
+    uint32_t cycles;   // tos_cpu_cycles
+    uint8_t  event;    // tos_trace_event_t
+    uint8_t  task;     // id of current task
+    uint16_t arg;
+} tos_trace_record_t;
+
+
+/**
+ * @brief start recording the events
+ *
+ * @param mask bits of events, TOS_TRACE_MASK_ALL or tos_trace_bit(...) | ...
+ */
+void tos_trace_start(uint32_t mask);
+
+/**
+ * @brief stop recording, the records are kept
+ *
+ */
+void tos_trace_stop(void);
+
+/**
+ * @brief drop all records
+ *
+ */
+void tos_trace_clear(void);
+
+/**
+ * @brief print the records by util_printk, recording is paused during dump
+ *
+ * @note text format, one line each:
+ *       tos-trace <version> <cycles_hz> <record number>
+ *       task <id> <prio> <name>              -- tasks alive at dump
+ *       <cycles> <event> <task> <arg>        -- records in hex, the oldest first
+ *       end
+ */
+void tos_trace_dump(void);
+
+
+#endif
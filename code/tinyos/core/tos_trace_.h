@@ -0,0 +1,69 @@
+/**
+ * @file tos_trace_.h
+ * @brief kernel event trace
+ * @note private, not for user
+ */
+
+#ifndef _TOS_TRACE__H_
+#define _TOS_TRACE__H_
+
+
+#include "tos_config.h"
+#include "tos_core_.h"
+#include "tos_cpu.h"
+#include "tos_trace.h"
+
+
+#define tos_trace_obj(obj) ((uint16_t)((uintptr_t)(obj) >> 3))   // low bits of the object address
+
+
+#if TOS_TRACE_ENABLE
+
+#if (TOS_TRACE_BUF_SIZE & (TOS_TRACE_BUF_SIZE - 1)) != 0
+#error "TOS_TRACE_BUF_SIZE should be power of 2"
+#endif
+
+typedef struct {
+    volatile uint32_t  mask;    // events to record
+    volatile uintptr_t head;    // records written, the ring index is head % TOS_TRACE_BUF_SIZE
+    tos_trace_record_t records[TOS_TRACE_BUF_SIZE];
+} tos_trace_ring_t;
+
+extern tos_trace_ring_t tos_trace_ring;
+extern tos_task_tcb_t*  tos_task_current;
+
+
+/**
+ * @brief record an event
+ *
+ * @param event
+ * @param arg
+ * @note lock-free, irq is not masked. the slot is claimed by CAS, so ISR could preempt anywhere,
+ *       timestamps of neighbour records may be out of order a little
+ */
+static inline void tos_trace(uint8_t event, uint16_t arg)
+{
+    uintptr_t head;
+
+    if ((tos_trace_ring.mask & tos_trace_bit(event)) == 0) {
+        return;
+    }
+
+    do {
+        head = tos_trace_ring.head;
+    } while (!tos_cpu_cas(&tos_trace_ring.head, head, head + 1));
+
+    tos_trace_record_t* record = &tos_trace_ring.records[head & (TOS_TRACE_BUF_SIZE - 1)];
+
+    record->cycles = tos_cpu_cycles();
+    record->event  = event;
+    record->task   = (tos_task_current != nullptr) ? (uint8_t)tos_task_current->task_id : TOS_TRACE_NO_TASK;
+    record->arg    = arg;
+}
+
+#else
+#define tos_trace(event, arg)
+#endif
+
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file tos_work.c
+ * @brief deferred work of ISRs
+ * @note the queue is a lock-free stack pushed by CAS, the work task takes all items at once and reverses
+ *       them to submit order. the work task is woken up by task notification when the stack was empty
+ */
+
+#include "tos_work.h"
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_cpu.h"
+#include "tos_notify.h"
+#include "tos_trace_.h"
+#include "tos_work_.h"
+#include "util_misc.h"
+#include "util_queue.h"
+
+#include <string.h>
+
+
+static void        tos_work_task_proc(void* args);
+static tos_work_t* tos_work_take_all(void);
+
+
+static volatile uintptr_t tos_work_head;   // top of the stack of submitted items, 0 if empty
+static tos_task_t         tos_work_task;   // work task
+static tos_task_storage_t tos_work_task_tcb;
+static tos_stack_t        tos_work_task_stack[TOS_WORK_TASK_STACK_SIZE / sizeof(tos_stack_t)];
+#if TOS_LATENCY_STAT_ENABLE
+static util_queue_node_t tos_work_all_list = {&tos_work_all_list, &tos_work_all_list};   // all work items
+#endif
+
+
+bool tos_work_task_init(void)
+{
+    tos_task_attr_t task_attr;
+
+    tos_work_head = 0;
+
+    task_attr.task_name       = "work";
+    task_attr.task_wait_time  = 0;
+    task_attr.task_time_slice = 0;
+    task_attr.task_prio       = TOS_WORK_TASK_PRIO;
+    task_attr.task_stack_size = TOS_WORK_TASK_STACK_SIZE;
+    task_attr.task_stack      = tos_work_task_stack;
+
+    tos_work_task = tos_task_create_static(tos_work_task_proc, nullptr, &task_attr, &tos_work_task_tcb);
+
+    return tos_work_task != nullptr;
+}
+
+
+/**
+ * @brief
+ *
+ * @param work
+ * @param name
+ * @param proc
+ * @param arg
+ * @return int
+ */
+int tos_work_init(tos_work_t* work, const char* name, tos_work_proc_t proc, void* arg)
+{
+    if (work == nullptr || proc == nullptr) {
+        return TOS_ERR_WORK_NULLPTR;
+    }
+
+    work->proc          = proc;
+    work->arg           = arg;
+    work->name          = (name != nullptr) ? name : "-";
+    work->next          = nullptr;
+    work->queued        = 0;
+    work->submit_cycles = 0;
+
+#if TOS_LATENCY_STAT_ENABLE
+    tos_use_critical_section();
+
+    work->busy_cnt = 0;
+    work->run_max  = 0;
+    memset(&work->latency, 0, sizeof(work->latency));
+    tos_enter_critical_section();
+    util_queue_insert(&tos_work_all_list, &work->all_link);
+    tos_leave_critical_section();
+#endif
+
+    return 0;
+}
+
+
+/**
+ * @brief
+ *
+ * @param work
+ * @return int
+ */
+int tos_work_submit(tos_work_t* work)
+{
+    uintptr_t head;
+
+    if (work == nullptr) {
+        return TOS_ERR_WORK_NULLPTR;
+    }
+
+    // in the queue, it will run after this submit anyway
+    if (!tos_cpu_cas(&work->queued, 0, 1)) {
+#if TOS_LATENCY_STAT_ENABLE
+        work->busy_cnt++;
+#endif
+        return TOS_ERR_WORK_BUSY;
+    }
+
+    work->submit_cycles = tos_cpu_cycles();
+    do {
+        head       = tos_work_head;
+        work->next = (tos_work_t*)head;
+    } while (!tos_cpu_cas(&tos_work_head, head, (uintptr_t)work));
+
+    // the work task takes all items at once, it needs a wakeup only for the first one
+    if (head == 0) {
+        tos_task_notify(&tos_work_task, 0, TOS_NOTIFY_NONE);
+    }
+
+    return 0;
+}
+
+
+uint32_t tos_get_work_stats(tos_work_stat_t* stats, uint32_t num)
+{
+    uint32_t count = 0;
+
+#if TOS_LATENCY_STAT_ENABLE
+    tos_use_critical_section();
+
+    if (stats == nullptr) {
+        return 0;
+    }
+
+    tos_enter_critical_section();
+    util_queue_foreach(node, &tos_work_all_list)
+    {
+        tos_work_t* work = util_containerof(tos_work_t, all_link, node);
+
+        if (count >= num) {
+            break;
+        }
+        stats[count].work     = work;
+        stats[count].name     = work->name;
+        stats[count].busy_cnt = work->busy_cnt;
+        stats[count].run_max  = work->run_max;
+        stats[count].latency  = work->latency;
+        count++;
+    }
+    tos_leave_critical_section();
+#endif
+
+    return count;
+}
+
+
+/**
+ * @brief work task, run the submitted items with irq enabled
+ *
+ * @param args
+ */
+static void tos_work_task_proc(void* args)
+{
+    while (true) {
+        tos_work_t* work = tos_work_take_all();
+
+        while (work != nullptr) {
+            tos_work_t* next = work->next;
+#if TOS_LATENCY_STAT_ENABLE
+            uint32_t start   = tos_cpu_cycles();
+            uint32_t latency = start - work->submit_cycles;
+#endif
+
+            // submitted again from now on
+            work->queued = 0;
+            work->proc(work->arg);
+
+#if TOS_LATENCY_STAT_ENABLE
+            uint32_t run = tos_cpu_cycles() - start;
+
+            tos_hist_add(&work->latency, latency);
+            if (run > work->run_max) {
+                work->run_max = run;
+            }
+#endif
+            work = next;
+        }
+
+        tos_task_notify_wait(0, nullptr, TOS_NOTIFY_WAIT_INFINITE);
+    }
+}
+
+
+/**
+ * @brief take all submitted items
+ *
+ * @return tos_work_t* list in submit order
+ */
+static tos_work_t* tos_work_take_all(void)
+{
+    uintptr_t   head;
+    tos_work_t* list = nullptr;
+
+    do {
+        head = tos_work_head;
+    } while (head != 0 && !tos_cpu_cas(&tos_work_head, head, 0));
+
+    // the stack is in reverse order of submit
+    for (tos_work_t* work = (tos_work_t*)head; work != nullptr;) {
+        tos_work_t* next = work->next;
+
+        work->next = list;
+        list       = work;
+        work       = next;
+    }
+
+    return list;
+}
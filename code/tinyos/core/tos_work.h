@@ -0,0 +1,79 @@
+/**
+ * @file tos_work.h
+ * @brief deferred work of ISRs (bottom halves), run by the work task with irq enabled
+ * @note ISRs submit work items to a lock-free queue, the work task runs them in submit order
+ */
+
+#ifndef _TOS_WORK_H_
+#define _TOS_WORK_H_
+
+
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_types.h"
+#include "util_queue.h"
+
+
+#define TOS_ERR_WORK_NULLPTR -1
+#define TOS_ERR_WORK_BUSY    -5   // submitted and not run yet, merged into the pending one
+
+
+typedef void (*tos_work_proc_t)(void* arg);
+
+// work item, static or global, fields are private
+typedef struct tos_work_t {
+    tos_work_proc_t             proc;
+    void*                       arg;
+    const char*                 name;
+    struct tos_work_t* volatile next;            // link in the queue
+    volatile uintptr_t          queued;          // 1 from submit to run, set by CAS
+    uint32_t                    submit_cycles;   // when submitted
+#if TOS_LATENCY_STAT_ENABLE
+    util_queue_node_t all_link;    // link into list of all work items
+    uint32_t          busy_cnt;    // submits merged
+    uint32_t          run_max;     // max cycles of proc
+    tos_hist_t        latency;     // cycles from submit to run
+#endif
+} tos_work_t;
+
+typedef struct {
+    tos_work_t* work;
+    const char* name;
+    uint32_t    busy_cnt;   // submits merged into the pending one
+    uint32_t    run_max;    // max cycles of proc
+    tos_hist_t  latency;    // cycles from submit to run, total is the number of runs
+} tos_work_stat_t;
+
+
+/**
+ * @brief
+ *
+ * @param work
+ * @param name for stats
+ * @param proc
+ * @param arg
+ * @return int
+ * @note call it before the work is submitted, not in ISR
+ */
+int tos_work_init(tos_work_t* work, const char* name, tos_work_proc_t proc, void* arg);
+
+/**
+ * @brief queue the work to the work task
+ *
+ * @param work
+ * @return int 0, or TOS_ERR_WORK_BUSY if it's still in the queue
+ * @note ISR safe, lock free
+ */
+int tos_work_submit(tos_work_t* work);
+
+/**
+ * @brief snapshot stats of all work items
+ *
+ * @param stats buffer of stats
+ * @param num max number of stats
+ * @return uint32_t number of stats stored, 0 if TOS_LATENCY_STAT_ENABLE is 0
+ */
+uint32_t tos_get_work_stats(tos_work_stat_t* stats, uint32_t num);
+
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file tos_work_.h
+ * @brief deferred work of ISRs
+ * @note private, not for user
+ */
+
+#ifndef _TOS_WORK__H_
+#define _TOS_WORK__H_
+
+
+#include "tos_types.h"
+#include "tos_work.h"
+
+
+/**
+ * @brief create the work task
+ *
+ * @return true
+ * @return false
+ */
+bool tos_work_task_init(void);
+
+
+#endif
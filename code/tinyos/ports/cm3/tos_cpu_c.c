@@ -11,6 +11,38 @@
 #include "tos_cpu.h"
 
 
+// clang-format off
+#define SYSTICK_CTRL            (*(volatile uint32_t*)0xE000E010)
+#define SYSTICK_LOAD            (*(volatile uint32_t*)0xE000E014)
+#define SYSTICK_VAL             (*(volatile uint32_t*)0xE000E018)
+#define SCB_ICSR                (*(volatile uint32_t*)0xE000ED04)
+#define DEMCR                   (*(volatile uint32_t*)0xE000EDFC)
+#define DWT_CTRL                (*(volatile uint32_t*)0xE0001000)
+#define DWT_CYCCNT              (*(volatile uint32_t*)0xE0001004)
+
+#define SYSTICK_CTRL_ENABLE     (1u << 0)
+#define SYSTICK_CTRL_COUNTFLAG  (1u << 16)
+#define SCB_ICSR_PENDSTSET      (1u << 26)
+#define SCB_ICSR_PENDSTCLR      (1u << 25)
+#define DEMCR_TRCENA            (1u << 24)
+#define DWT_CTRL_CYCCNTENA      (1u << 0)
+
+#define SYSTICK_TICK_COUNTS     (MCU_SYS_CLOCK / TOS_SYS_HZ)
+#define SYSTICK_MAX_TICKS       (0x00FFFFFFu / SYSTICK_TICK_COUNTS)   // 24-bit counter
+// clang-format on
+
+#if defined(__CC_ARM)
+#define tos_cpu_wfi()                                                                                                  \
+    do {                                                                                                               \
+        __dsb(0xF);                                                                                                    \
+        __wfi();                                                                                                       \
+        __isb(0xF);                                                                                                    \
+    } while (0)
+#else
+#define tos_cpu_wfi() __asm volatile("dsb\n\twfi\n\tisb" ::: "memory")
+#endif
+
+
 /**
  * @brief OS Tick init
  *
@@ -26,6 +58,123 @@ void tos_sys_clock_init(void)
     // SysTick->CTRL
     *(volatile unsigned int*)0xE000E010 |= (1u << 2) | 1u;   // AHB clk, enable systick counter
     *(volatile unsigned int*)0xE000E010 |= (1u << 1);        // enable systick irq
+
+    // cycle counter for cpu time accounting
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+
+/**
+ * @brief stop the periodic tick and sleep the cpu, wakeup after ticks or by other irq
+ *
+ * @param ticks max ticks to sleep
+ * @return uint32_t ticks elapsed during sleep
+ * @note called with irq disabled, WFI still wakes up on a pending irq
+ */
+uint32_t tos_sys_clock_sleep(uint32_t ticks)
+{
+    uint32_t counts = SYSTICK_TICK_COUNTS;
+    uint32_t ctrl, to_next, reload, passed, elapsed;
+
+    if (ticks > SYSTICK_MAX_TICKS) {
+        ticks = SYSTICK_MAX_TICKS;
+    }
+
+    SYSTICK_CTRL &= ~SYSTICK_CTRL_ENABLE;
+
+    // a tick is pending, let the ISR handle it
+    if (SCB_ICSR & SCB_ICSR_PENDSTSET) {
+        SYSTICK_CTRL |= SYSTICK_CTRL_ENABLE;
+        return 0;
+    }
+
+    // one-shot: rest of the current tick + (ticks - 1) ticks
+    to_next      = SYSTICK_VAL;
+    reload       = to_next + (ticks - 1) * counts;
+    SYSTICK_LOAD = reload;
+    SYSTICK_VAL  = 0;
+    SYSTICK_CTRL |= SYSTICK_CTRL_ENABLE;
+
+    tos_cpu_wfi();
+
+    ctrl         = SYSTICK_CTRL;   // read clears COUNTFLAG
+    SYSTICK_CTRL = ctrl & ~SYSTICK_CTRL_ENABLE;
+
+    if (ctrl & SYSTICK_CTRL_COUNTFLAG) {
+        // wakeup by the tick, counted here instead of the ISR
+        SCB_ICSR = SCB_ICSR_PENDSTCLR;
+        elapsed  = ticks;
+        passed   = reload - SYSTICK_VAL;   // counts since reloaded
+        to_next  = (passed < counts) ? counts - passed : 1;
+    } else {
+        // wakeup by other irq
+        passed = reload - SYSTICK_VAL;
+        if (passed < to_next) {
+            elapsed = 0;
+            to_next = to_next - passed;
+        } else {
+            passed -= to_next;
+            elapsed = 1 + passed / counts;
+            to_next = counts - passed % counts;
+        }
+    }
+
+    // finish the current tick, then back to periodic
+    SYSTICK_LOAD = to_next;
+    SYSTICK_VAL  = 0;
+    SYSTICK_CTRL |= SYSTICK_CTRL_ENABLE;
+    SYSTICK_LOAD = counts;
+
+    return elapsed;
+}
+
+
+/**
+ * @brief atomic compare and swap by LDREX/STREX
+ *
+ * @param addr
+ * @param expected
+ * @param desired
+ * @return true if stored
+ * @note the exclusive monitor is cleared by exception entry/return, so STREX fails if interrupted
+ */
+bool tos_cpu_cas(volatile uintptr_t* addr, uintptr_t expected, uintptr_t desired)
+{
+#if defined(__CC_ARM)
+    do {
+        if (__ldrex(addr) != expected) {
+            __clrex();
+            return false;
+        }
+    } while (__strex(desired, addr) != 0);
+#else
+    uintptr_t value;
+    uint32_t  failed;
+
+    do {
+        __asm volatile("ldrex %0, [%1]" : "=r"(value) : "r"(addr) : "memory");
+        if (value != expected) {
+            __asm volatile("clrex" ::: "memory");
+            return false;
+        }
+        __asm volatile("strex %0, %2, [%1]" : "=&r"(failed) : "r"(addr), "r"(desired) : "memory");
+    } while (failed != 0);
+#endif
+
+    return true;
+}
+
+
+/**
+ * @brief free running cycle counter
+ *
+ * @return uint32_t DWT CYCCNT, wraps in about 60s at 72MHz
+ * @note enabled by tos_sys_clock_init
+ */
+uint32_t tos_cpu_cycles(void)
+{
+    return DWT_CYCCNT;
 }
 
 
@@ -0,0 +1,451 @@
+/**
+ * @file tos_cpu_c.c
+ * @brief cpu dependency functions for linux/posix host
+ * @note task context is ucontext, SIGALRM plays the SysTick, irq mask is emulated by a flag,
+ *       other signals can be attached as irqs by tos_cpu_irq_attach
+ */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "tos_config.h"
+#include "tos_core.h"
+#include "tos_core_.h"
+#include "tos_cpu.h"
+
+
+#define POSIX_FRAME_ALIGN     16u
+#define POSIX_TICK_US         (1000000u / TOS_SYS_HZ)
+#define POSIX_SLEEP_TICKS_MAX (3600u * TOS_SYS_HZ)   // one hour
+#define POSIX_IRQ_NUM_MAX     8u
+#define POSIX_IRQ_SYSTICK     0u                     // irq 0 is always the SysTick
+
+
+/*
+ task frame, placed at the top of task stack
+    context : cpu context of the task
+    started : context will be made at the first switch, when the stack bottom is known from tcb
+ */
+typedef struct {
+    ucontext_t      context;
+    tos_task_proc_t proc;
+    void*           args;
+    bool            started;
+} posix_task_frame_t;
+
+typedef struct {
+    int signo;
+    void (*isr)(void);
+} posix_irq_t;
+
+
+extern uint32_t        tos_task_prio_current;
+extern uint32_t        tos_task_prio_switch_to;
+extern tos_task_tcb_t* tos_task_current;
+extern tos_task_tcb_t* tos_task_switch_to;
+
+static volatile sig_atomic_t posix_irq_masked  = 1;       // like PRIMASK, 1: irq disabled
+static volatile uint32_t     posix_irq_pending = 0;       // bits of irqs arrived when irq disabled, atomic
+static bool                  posix_task_exited = false;   // current task returned, do not save its context
+static posix_irq_t           posix_irqs[POSIX_IRQ_NUM_MAX] = {{SIGALRM, tos_systick_isr}};
+static uint32_t              posix_irq_num                 = 1;
+
+
+static void                posix_irq_replay(void);
+static void                posix_irq_handler(int signo);
+static void                posix_irq_unblock(sigset_t* mask);
+static void                posix_task_entry(void);
+static posix_task_frame_t* posix_task_frame_prepare(tos_task_tcb_t* tcb);
+
+
+/**
+ * @brief OS Tick init
+ *
+ */
+void tos_sys_clock_init(void)
+{
+    struct sigaction act;
+    struct itimerval timer;
+
+    act.sa_handler = posix_irq_handler;
+    act.sa_flags   = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGALRM, &act, nullptr);
+
+    timer.it_interval.tv_sec  = 0;
+    timer.it_interval.tv_usec = POSIX_TICK_US;
+    timer.it_value            = timer.it_interval;
+    setitimer(ITIMER_REAL, &timer, nullptr);
+}
+
+
+/**
+ * @brief stop the periodic tick and sleep the process, wakeup after ticks or by other signal
+ *
+ * @param ticks max ticks to sleep
+ * @return uint32_t ticks elapsed during sleep
+ * @note called with irq disabled
+ */
+uint32_t tos_sys_clock_sleep(uint32_t ticks)
+{
+    struct itimerval timer;
+    struct timespec  start, end;
+    sigset_t         alarm_mask, wait_mask;
+    uint64_t         to_next, slept;
+    uint32_t         elapsed;
+
+    // block SIGALRM until sigsuspend, so the one-shot can not be lost
+    sigemptyset(&alarm_mask);
+    sigaddset(&alarm_mask, SIGALRM);
+    sigprocmask(SIG_BLOCK, &alarm_mask, &wait_mask);
+    posix_irq_unblock(&wait_mask);   // other irqs wakeup the sleep too
+
+    getitimer(ITIMER_REAL, &timer);
+    to_next = timer.it_value.tv_sec * 1000000u + timer.it_value.tv_usec;
+
+    // a tick is pending or the clock is not started
+    if (posix_irq_pending || to_next == 0) {
+        sigprocmask(SIG_UNBLOCK, &alarm_mask, nullptr);
+        return 0;
+    }
+
+    if (ticks > POSIX_SLEEP_TICKS_MAX) {
+        ticks = POSIX_SLEEP_TICKS_MAX;
+    }
+
+    // one-shot: rest of the current tick + (ticks - 1) ticks
+    timer.it_interval.tv_sec  = 0;
+    timer.it_interval.tv_usec = 0;
+    slept                     = to_next + (uint64_t)(ticks - 1) * POSIX_TICK_US;
+    timer.it_value.tv_sec     = slept / 1000000u;
+    timer.it_value.tv_usec    = slept % 1000000u;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    sigsuspend(&wait_mask);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    __atomic_fetch_and(&posix_irq_pending, ~(1u << POSIX_IRQ_SYSTICK), __ATOMIC_SEQ_CST);   // counted here
+
+    slept = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000u + (end.tv_nsec - start.tv_nsec) / 1000;
+    if (slept < to_next) {
+        elapsed = 0;
+        to_next = to_next - slept;
+    } else {
+        slept -= to_next;
+        elapsed = 1 + slept / POSIX_TICK_US;
+        to_next = POSIX_TICK_US - slept % POSIX_TICK_US;
+    }
+
+    // finish the current tick, then back to periodic
+    timer.it_interval.tv_sec  = 0;
+    timer.it_interval.tv_usec = POSIX_TICK_US;
+    timer.it_value.tv_sec     = 0;
+    timer.it_value.tv_usec    = to_next;
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    sigprocmask(SIG_UNBLOCK, &alarm_mask, nullptr);
+    return elapsed;
+}
+
+
+/**
+ * @brief task stack frame init
+ *
+ * @param proc task proc
+ * @param args task arg
+ * @param stack_ptr task stack ptr
+ * @return tos_stack_t* ptr to current stack
+ * @note the stack space and size must be valid
+ */
+tos_stack_t* tos_task_stack_frame_init(tos_task_proc_t proc, void* args, tos_stack_t* stack_ptr)
+{
+    uintptr_t           frame_addr = (uintptr_t)(stack_ptr + 1) - sizeof(posix_task_frame_t);
+    posix_task_frame_t* frame      = (posix_task_frame_t*)(frame_addr & ~(uintptr_t)(POSIX_FRAME_ALIGN - 1));
+
+    frame->proc    = proc;
+    frame->args    = args;
+    frame->started = false;
+
+    return (tos_stack_t*)frame;
+}
+
+
+/**
+ * @brief switch to tos_task_switch_to, store cpu info of tos_task_current
+ *
+ * @note called in critical section
+ */
+void tos_task_switch(void)
+{
+    posix_task_frame_t* to = posix_task_frame_prepare(tos_task_switch_to);
+
+    if (posix_task_exited) {
+        // tcb of current task has been freed
+        posix_task_exited     = false;
+        tos_task_prio_current = tos_task_prio_switch_to;
+        tos_task_current      = tos_task_switch_to;
+        setcontext(&to->context);
+    }
+
+    posix_task_frame_t* from = (posix_task_frame_t*)tos_task_current->task_stk_ptr;
+
+    tos_task_prio_current = tos_task_prio_switch_to;
+    tos_task_current      = tos_task_switch_to;
+
+    swapcontext(&from->context, &to->context);
+    // back to this task, still in critical section, restored by the caller
+}
+
+
+/**
+ * @brief task switch when exit ISR
+ *
+ * @note the ISR runs on the stack of the interrupted task, so it's a normal switch
+ */
+void tos_task_switch_intr(void)
+{
+    tos_task_switch();
+}
+
+
+/**
+ * @brief start first task of TOS, do not store cpu info
+ *
+ */
+void tos_task_switch_first(void)
+{
+    posix_task_frame_t* to = posix_task_frame_prepare(tos_task_switch_to);
+
+    tos_task_prio_current = tos_task_prio_switch_to;
+    tos_task_current      = tos_task_switch_to;
+
+    setcontext(&to->context);
+
+    while (true) {
+        ;   // should never get here
+    }
+}
+
+
+/**
+ * @brief atomic compare and swap by C11 atomics
+ *
+ * @param addr
+ * @param expected
+ * @param desired
+ * @return true if stored
+ */
+bool tos_cpu_cas(volatile uintptr_t* addr, uintptr_t expected, uintptr_t desired)
+{
+    return atomic_compare_exchange_strong((volatile _Atomic uintptr_t*)addr, &expected, desired);
+}
+
+
+/**
+ * @brief free running cycle counter by the monotonic clock
+ *
+ * @return uint32_t microseconds, wraps in about 71 minutes, longer than the max tickless sleep
+ */
+uint32_t tos_cpu_cycles(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000u + now.tv_nsec / 1000);
+}
+
+
+/**
+ * @brief attach a signal as an irq, the isr runs like the SysTick: pended while irq is disabled,
+ *        and it should be wrapped by tos_enter_isr/tos_exit_isr
+ *
+ * @param signo
+ * @param isr
+ * @return int 0: ok
+ */
+int tos_cpu_irq_attach(int signo, void (*isr)(void))
+{
+    struct sigaction act;
+
+    if (posix_irq_num >= POSIX_IRQ_NUM_MAX || signo == SIGALRM || isr == nullptr) {
+        return -1;
+    }
+
+    posix_irqs[posix_irq_num].signo = signo;
+    posix_irqs[posix_irq_num].isr   = isr;
+    posix_irq_num++;
+
+    act.sa_handler = posix_irq_handler;
+    act.sa_flags   = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(signo, &act, nullptr);
+    return 0;
+}
+
+
+/**
+ * @brief disable CPU IRQ, return PRIMASK
+ *
+ * @return uint32_t
+ */
+uint32_t tos_irq_diable(void)
+{
+    uint32_t primask = posix_irq_masked;
+    posix_irq_masked = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    return primask;
+}
+
+
+/**
+ * @brief enable CPU IRQ
+ *
+ */
+void tos_irq_enable(void)
+{
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    posix_irq_masked = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (posix_irq_pending) {
+        posix_irq_replay();
+    }
+}
+
+
+/**
+ * @brief restore CPU IRQ, restore PRIMASK
+ *
+ * @param primask
+ */
+void tos_irq_restore(uint32_t primask)
+{
+    if (primask == 0) {
+        tos_irq_enable();
+    } else {
+        posix_irq_masked = 1;
+    }
+}
+
+
+/**
+ * @brief cpu SysTick ISR
+ *
+ */
+void tos_systick_isr(void)
+{
+    tos_enter_isr();   // enter ISR
+    tos_time_tick();
+    tos_exit_isr();   // leave ISR
+}
+
+
+/**
+ * @brief handle the irqs which arrived when irq disabled, like pending irqs of NVIC, lower irq number first
+ *
+ */
+static void posix_irq_replay(void)
+{
+    uint32_t pending;
+
+    while ((pending = __atomic_exchange_n(&posix_irq_pending, 0, __ATOMIC_SEQ_CST)) != 0) {
+        for (uint32_t irq = 0; irq < posix_irq_num; irq++) {
+            if (pending & (1u << irq)) {
+                posix_irqs[irq].isr();
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief handler of signals attached as irqs, runs on the stack of the interrupted task
+ *
+ * @param signo
+ */
+static void posix_irq_handler(int signo)
+{
+    for (uint32_t irq = 0; irq < posix_irq_num; irq++) {
+        if (posix_irqs[irq].signo == signo) {
+            if (posix_irq_masked) {
+                __atomic_fetch_or(&posix_irq_pending, 1u << irq, __ATOMIC_SEQ_CST);
+            } else {
+                posix_irqs[irq].isr();
+            }
+            return;
+        }
+    }
+}
+
+
+/**
+ * @brief remove signals of irqs from the mask
+ *
+ * @param mask
+ */
+static void posix_irq_unblock(sigset_t* mask)
+{
+    for (uint32_t irq = 0; irq < posix_irq_num; irq++) {
+        sigdelset(mask, posix_irqs[irq].signo);
+    }
+}
+
+
+/**
+ * @brief entry of all tasks, task proc should never return
+ *
+ */
+static void posix_task_entry(void)
+{
+    posix_task_frame_t* frame = (posix_task_frame_t*)tos_task_current->task_stk_ptr;
+
+    tos_irq_enable();   // irq disabled by tos_init or by the switcher
+    frame->proc(frame->args);
+
+    // task returned, delete it and never come back
+    tos_task_tcb_t* task = tos_get_current_task();
+    tos_irq_diable();
+    if (tos_task_delete(&task) != 0) {
+        // it holds messages of a msgq, keep it blocked as the others of the msgq may still work
+        tos_irq_enable();
+        while (true) {
+            tos_task_sleep(TOS_TIME_WAIT_INFINITY);
+        }
+    }
+    // the tcb may be freed, no one should touch it as the task switched out
+    tos_task_current  = nullptr;
+    posix_task_exited = true;
+    tos_schedule();
+}
+
+
+/**
+ * @brief make the task context at the first switch
+ *
+ * @param tcb
+ * @return posix_task_frame_t*
+ */
+static posix_task_frame_t* posix_task_frame_prepare(tos_task_tcb_t* tcb)
+{
+    posix_task_frame_t* frame = (posix_task_frame_t*)tcb->task_stk_ptr;
+
+    if (!frame->started) {
+        uint8_t* stack_bottom = (uint8_t*)(tcb->task_stk_top + 1);
+
+        getcontext(&frame->context);
+        frame->context.uc_stack.ss_sp   = stack_bottom;
+        frame->context.uc_stack.ss_size = (uint8_t*)frame - stack_bottom;
+        frame->context.uc_link          = nullptr;
+        posix_irq_unblock(&frame->context.uc_sigmask);
+        makecontext(&frame->context, posix_task_entry, 0);
+        frame->started = true;
+    }
+
+    return frame;
+}
@@ -23,6 +23,19 @@ void tos_sys_clock_init(void)
 }
 
 
+/**
+ * @brief stop the periodic tick and sleep the cpu
+ *
+ * @param ticks
+ * @return uint32_t
+ * @note tickless is not supported by this port, keep the tick and return immediately
+ */
+uint32_t tos_sys_clock_sleep(uint32_t ticks)
+{
+    return 0;
+}
+
+
 /**
  * @brief task stack frame init
  *
@@ -78,6 +91,74 @@ tos_stack_t* tos_task_stack_frame_init(tos_task_proc_t proc, void* args, tos_sta
 }
 
 
+/**
+ * @brief compare and swap by masking irq
+ *
+ * @param addr
+ * @param expected
+ * @param desired
+ * @return true if stored
+ */
+bool tos_cpu_cas(volatile uintptr_t* addr, uintptr_t expected, uintptr_t desired)
+{
+    uint32_t primask = tos_irq_diable();
+    bool     stored  = (*addr == expected);
+
+    if (stored) {
+        *addr = desired;
+    }
+    tos_irq_restore(primask);
+
+    return stored;
+}
+
+
+/**
+ * @brief free running cycle counter
+ *
+ * @return uint32_t
+ * @note no free running counter is set up by this port, fall back to sys ticks, accounting is tick-precise.
+ *       TOS_CPU_CYCLES_HZ is TOS_SYS_HZ for this port
+ */
+uint32_t tos_cpu_cycles(void)
+{
+    return tos_state.sys_ticks;
+}
+
+
+/**
+ * @brief count leading zeros, x should not be 0
+ *
+ * @param x
+ * @return uint32_t
+ */
+uint32_t tos_cpu_clz(uint32_t x)
+{
+    uint32_t n = 0;
+
+    if ((x & 0xFFFF0000u) == 0) {
+        n += 16;
+        x <<= 16;
+    }
+    if ((x & 0xFF000000u) == 0) {
+        n += 8;
+        x <<= 8;
+    }
+    if ((x & 0xF0000000u) == 0) {
+        n += 4;
+        x <<= 4;
+    }
+    if ((x & 0xC0000000u) == 0) {
+        n += 2;
+        x <<= 2;
+    }
+    if ((x & 0x80000000u) == 0) {
+        n += 1;
+    }
+    return n;
+}
+
+
 /**
  * @brief
  *
@@ -85,7 +166,12 @@ tos_stack_t* tos_task_stack_frame_init(tos_task_proc_t proc, void* args, tos_sta
 static void tos_task_return(void)
 {
     tos_task_tcb_t* task = tos_get_current_task();
-    tos_task_delete(&task);
+    if (tos_task_delete(&task) != 0) {
+        // it holds messages of a msgq, keep it blocked as the others of the msgq may still work
+        while (1) {
+            tos_task_sleep(TOS_TIME_WAIT_INFINITY);
+        }
+    }
     tos_schedule();
     while (1) {
         ;
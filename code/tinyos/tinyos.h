@@ -3,6 +3,15 @@
 
 #include "core/tos_core.h"
 #include "core/tos_cond.h"
+#include "core/tos_event.h"
+#include "core/tos_mempool.h"
+#include "core/tos_msgq.h"
 #include "core/tos_mutex.h"
+#include "core/tos_notify.h"
+#include "core/tos_sem.h"
+#include "core/tos_static.h"
+#include "core/tos_timer.h"
+#include "core/tos_trace.h"
+#include "core/tos_work.h"
 
 #endif
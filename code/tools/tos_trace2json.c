@@ -0,0 +1,268 @@
+/**
+ * @file tos_trace2json.c
+ * @brief host tool, convert a dump of tos_trace_dump to chrome/perfetto trace json
+ * @note usage: tos_trace2json [dump.txt] > trace.json, then open it by chrome://tracing or ui.perfetto.dev
+ *       lines before the dump header (console output, cli prompt) are skipped
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tos_trace.h"
+
+
+#define LINE_LEN_MAX   256
+#define TASK_NUM_MAX   256
+#define TASK_NAME_LEN  32
+#define TID_ISR        1000   // track of ISR and ticks
+#define TID_BOOT       TOS_TRACE_NO_TASK
+
+
+typedef struct {
+    tos_trace_record_t record;
+    uint32_t           index;   // order in the ring, keeps sort stable
+    double             ts;      // us since the first record
+} trace_event_t;
+
+
+static const char* event_names[] = {TOS_TRACE_EVENT_NAMES};
+static char        task_names[TASK_NUM_MAX][TASK_NAME_LEN];
+
+
+static int  trace_load(FILE* in, trace_event_t** events, uint32_t* count, uint32_t* cycles_hz);
+static void trace_timestamp(trace_event_t* events, uint32_t count, uint32_t cycles_hz);
+static int  trace_compare(const void* a, const void* b);
+static void trace_emit(const trace_event_t* events, uint32_t count);
+static void trace_emit_thread_name(int tid, const char* name, int* first);
+
+
+int main(int argc, char* argv[])
+{
+    FILE*          in     = stdin;
+    trace_event_t* events = NULL;
+    uint32_t       count = 0, cycles_hz = 0;
+
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "-h") == 0)) {
+        fprintf(stderr, "usage: %s [dump.txt] > trace.json\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2 && (in = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (trace_load(in, &events, &count, &cycles_hz) != 0) {
+        fprintf(stderr, "no tos-trace dump found\n");
+        return 1;
+    }
+
+    trace_timestamp(events, count, cycles_hz);
+    qsort(events, count, sizeof(trace_event_t), trace_compare);
+    trace_emit(events, count);
+
+    fprintf(stderr, "%u records, %u cycles/s\n", count, cycles_hz);
+    free(events);
+    return 0;
+}
+
+
+/**
+ * @brief parse the text dump
+ *
+ * @param in
+ * @param events records, malloc'ed
+ * @param count
+ * @param cycles_hz
+ * @return int 0: ok
+ */
+static int trace_load(FILE* in, trace_event_t** events, uint32_t* count, uint32_t* cycles_hz)
+{
+    char     line[LINE_LEN_MAX];
+    char     name[TASK_NAME_LEN];
+    uint32_t version, number, id, prio, cycles, event, task, arg;
+    bool     started = false;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char* header = strstr(line, "tos-trace ");
+
+        if (!started) {
+            if (header != NULL && sscanf(header, "tos-trace %u %u %u", &version, cycles_hz, &number) == 3) {
+                if (version != TOS_TRACE_VERSION || *cycles_hz == 0) {
+                    fprintf(stderr, "unsupported dump, version %u, %u cycles/s\n", version, *cycles_hz);
+                    return -1;
+                }
+                *events = calloc(number + 1, sizeof(trace_event_t));
+                *count  = 0;
+                started = true;
+            }
+            continue;
+        }
+
+        if (strncmp(line, "end", 3) == 0) {
+            return 0;
+        } else if (sscanf(line, "task %u %u %31s", &id, &prio, name) == 3) {
+            if (id < TASK_NUM_MAX) {
+                snprintf(task_names[id], sizeof(task_names[id]), "%s", name);
+            }
+        } else if (sscanf(line, "%x %x %x %x", &cycles, &event, &task, &arg) == 4 && *count < number) {
+            trace_event_t* e = &(*events)[*count];
+            e->record.cycles = cycles;
+            e->record.event  = (uint8_t)event;
+            e->record.task   = (uint8_t)task;
+            e->record.arg    = (uint16_t)arg;
+            e->index         = *count;
+            (*count)++;
+        }
+    }
+
+    // dump is cut, use what we have
+    return started ? 0 : -1;
+}
+
+
+/**
+ * @brief unwrap the 32-bit cycles in ring order, and convert to us
+ *
+ * @param events
+ * @param count
+ * @param cycles_hz
+ * @note neighbour records may be a little out of order, the difference is signed
+ */
+static void trace_timestamp(trace_event_t* events, uint32_t count, uint32_t cycles_hz)
+{
+    int64_t cycles = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0) {
+            cycles += (int32_t)(events[i].record.cycles - events[i - 1].record.cycles);
+        }
+        events[i].ts = (double)cycles * 1e6 / cycles_hz;
+    }
+}
+
+
+static int trace_compare(const void* a, const void* b)
+{
+    const trace_event_t* ea = a;
+    const trace_event_t* eb = b;
+
+    if (ea->ts != eb->ts) {
+        return (ea->ts < eb->ts) ? -1 : 1;
+    }
+    return (ea->index < eb->index) ? -1 : 1;
+}
+
+
+/**
+ * @brief print trace json to stdout
+ *
+ * @param events sorted
+ * @param count
+ * @note running of tasks are complete events on the track of each task, ISRs are begin/end events on the ISR track,
+ *       others are instant events
+ */
+static void trace_emit(const trace_event_t* events, uint32_t count)
+{
+    bool   seen[TASK_NUM_MAX] = {false};
+    int    first              = 1;
+    int    running            = -1;
+    int    isr_depth          = 0;
+    double run_start          = 0;
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const tos_trace_record_t* r     = &events[i].record;
+        double                    ts    = events[i].ts;
+        const char*               event = (r->event < TOS_TRACE_EVENT_NUM) ? event_names[r->event] : "unknown";
+
+        seen[r->task] = true;
+        if (r->event == TOS_TRACE_SWITCH && r->arg < TASK_NUM_MAX) {
+            seen[r->arg] = true;
+        }
+
+        switch (r->event) {
+        case TOS_TRACE_SWITCH:
+            // the task switched out was running since the last switch, or since the first record
+            if (running < 0) {
+                running   = r->task;
+                run_start = events[0].ts;
+            }
+            printf("%s{\"name\":\"running\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+                   running, run_start, ts - run_start);
+            running   = r->arg;
+            run_start = ts;
+            break;
+
+        case TOS_TRACE_ISR_ENTER:
+            printf("%s{\"name\":\"isr\",\"ph\":\"B\",\"pid\":0,\"tid\":%d,\"ts\":%.3f}", first ? "" : ",\n", TID_ISR, ts);
+            isr_depth++;
+            break;
+
+        case TOS_TRACE_ISR_EXIT:
+            if (isr_depth == 0) {
+                continue;   // entered before the oldest record
+            }
+            printf("%s{\"name\":\"isr\",\"ph\":\"E\",\"pid\":0,\"tid\":%d,\"ts\":%.3f}", first ? "" : ",\n", TID_ISR, ts);
+            isr_depth--;
+            break;
+
+        case TOS_TRACE_TICK:
+            printf("%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"tick\":%u}}",
+                   first ? "" : ",\n", event, TID_ISR, ts, r->arg);
+            break;
+
+        case TOS_TRACE_TASK_CREATE:
+        case TOS_TRACE_TASK_DELETE:
+        case TOS_TRACE_NOTIFY:
+            printf("%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%u}}",
+                   first ? "" : ",\n", event, r->task, ts, r->arg);
+            break;
+
+        default:
+            printf("%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,"
+                   "\"args\":{\"obj\":\"0x%04x\"}}",
+                   first ? "" : ",\n", event, r->task, ts, r->arg);
+            break;
+        }
+        first = 0;
+    }
+
+    if (running >= 0) {
+        printf(",\n{\"name\":\"running\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", running, run_start,
+               events[count - 1].ts - run_start);
+    }
+
+    // names of tracks
+    printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"tinyos\"}}", first ? "" : ",\n");
+    first = 0;
+    trace_emit_thread_name(TID_ISR, "isr", &first);
+    for (int tid = 0; tid < TASK_NUM_MAX; tid++) {
+        char name[TASK_NAME_LEN + 16];
+
+        if (!seen[tid]) {
+            continue;
+        }
+        if (tid == TID_BOOT) {
+            snprintf(name, sizeof(name), "boot");
+        } else if (task_names[tid][0] != '\0') {
+            snprintf(name, sizeof(name), "%d %.*s", tid, TASK_NAME_LEN, task_names[tid]);
+        } else {
+            snprintf(name, sizeof(name), "%d task", tid);   // deleted before the dump
+        }
+        trace_emit_thread_name(tid, name, &first);
+    }
+
+    printf("\n]}\n");
+}
+
+
+static void trace_emit_thread_name(int tid, const char* name, int* first)
+{
+    printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+           *first ? "" : ",\n", tid, name);
+    *first = 0;
+}
@@ -7,6 +7,26 @@
 #include "util_misc.h"
 #include "util_queue.h"
 
+
+void* util_calloc(util_size_t num, util_size_t size)
+{
+    // overflow
+    if (size != 0 && num > (util_size_t)-1 / size) {
+        return nullptr;
+    }
+
+    void* ptr = util_malloc(num * size);
+
+    if (ptr != nullptr) {
+        memset(ptr, 0, num * size);
+    }
+
+    return ptr;
+}
+
+
+#if UTIL_HEAP_BACKEND == UTIL_HEAP_BACKEND_SLOT
+
 // #pragma anon_unions
 
 // clang-format off
@@ -58,6 +78,7 @@ typedef struct {
 #define blk_set_size(blk, nbytes)  (blk->size = ((nbytes) & HEAP_BLK_SIZE_MASK) | HEAP_BLK_MAGIC_MASK)
 #define blk_chk_magic(blk)         ((blk->size & HEAP_BLK_MAGIC_MASK) == HEAP_BLK_MAGIC_MASK)
 #define blk_size_roundup(nbytes)   (((nbytes) + HEAP_BLK_SIZE_UNIT - 1) & ~(HEAP_BLK_SIZE_UNIT - 1))
+#define blk_size_of(nbytes)        blk_size_roundup(util_max2((nbytes) + HEAP_BLK_HEAD_SIZE, HEAP_BLK_MIN_SIZE))
 
 #define blk2userptr(blk)           blk->user_space
 #define userptr2blk(uptr)          (memblk_t*)((uint8_t*)uptr - HEAP_BLK_HEAD_SIZE)
@@ -69,6 +90,7 @@ static util_queue_node_t heap_free_blocks[HEAP_BLK_SLOT_NUM];   //
 static util_queue_node_t heap_all_blocks;                       // list of blk, order by addr
 static util_size_t       heap_free_size = 0;
 static bool              heap_inited    = false;
+static util_heap_stat_t  heap_stat;                             // counters, the others are got by util_heap_stat
 
 
 static void      heap_init(void);
@@ -76,6 +98,12 @@ static memblk_t* heap_alloc_blk(util_size_t nbytes);
 static void      heap_free_blk(memblk_t* blk);
 static memblk_t* heap_get_blk_from_slot(util_size_t nbytes, util_size_t slot);
 static void      heap_add_free_blk_by_size(memblk_t* blk);
+static void      heap_rm_free_blk(memblk_t* blk);
+static void      heap_trim_blk(memblk_t* blk, util_size_t nbytes);
+static bool      heap_grow_blk(memblk_t* blk, util_size_t nbytes);
+static memblk_t* heap_userptr2blk(void* ptr);
+static void      heap_stat_alloc(util_size_t nbytes);
+static void      heap_stat_peak(void);
 
 
 void* util_malloc(util_size_t nbytes)
@@ -93,17 +121,16 @@ void* util_malloc(util_size_t nbytes)
         heap_init();
     }
 
-    // check nbytes valid
-    cond_check((blk_size > heap_free_size), return nullptr);
-
-    memblk_t* blk = heap_alloc_blk(blk_size);
+    memblk_t* blk = (blk_size > heap_free_size) ? nullptr : heap_alloc_blk(blk_size);
 
     if (blk != nullptr) {
         heap_log("- malloc %d bytes @0x%08x\n", blk->size, (util_size_t)blk);
         blk_set_size(blk, blk->size - HEAP_BLK_HEAD_SIZE);
+        heap_stat_alloc(nbytes);
         return blk->user_space;
     } else {
         heap_err("! malloc fail\n");
+        heap_stat.fail_cnt++;
         return nullptr;
     }
 }
@@ -115,26 +142,62 @@ void util_free(void* ptr)
         return;
     }
 
-    cond_check((!heap_inited), return);
+    memblk_t* blk = heap_userptr2blk(ptr);
 
-    // check addr align
-    cond_check((((util_size_t)ptr & (HEAP_ADDR_ALIGN - 1)) != 0), return);
+    if (blk != nullptr) {
+        blk->size = blk_get_size(blk) + HEAP_BLK_HEAD_SIZE;
+        heap_free_blk(blk);
+        heap_stat.free_cnt++;
+    }
+}
 
-    // check addr in heap field
-    cond_check(((uint8_t*)ptr < (uint8_t*)HEAP_ADDR_START || (uint8_t*)ptr > (uint8_t*)HEAP_ADDR_END), return);
 
-    memblk_t* blk = userptr2blk(ptr);
+void* util_malloc_aligned(util_size_t nbytes, util_size_t align)
+{
+    // not power of 2
+    cond_check((align == 0 || (align & (align - 1)) != 0), return nullptr);
 
-    // check block magic
-    cond_check((!blk_chk_magic(blk)), return);
+    if (align <= HEAP_ADDR_ALIGN) {
+        return util_malloc(nbytes);
+    }
+    if (nbytes == 0 || nbytes > HEAP_SIZE || align > HEAP_SIZE) {
+        return nullptr;
+    }
 
-    util_size_t blk_size = blk_get_size(blk) + HEAP_BLK_HEAD_SIZE;
+    util_size_t blk_size = blk_size_of(nbytes);
 
-    // check block size
-    cond_check(((uint8_t*)blk + blk_size > (uint8_t*)HEAP_ADDR_END), return);
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    // room to put a free block before the aligned one
+    memblk_t* blk = heap_alloc_blk(blk_size + align + HEAP_BLK_MIN_SIZE);
+    if (blk == nullptr) {
+        heap_err("! malloc fail\n");
+        heap_stat.fail_cnt++;
+        return nullptr;
+    }
+
+    uintptr_t uptr = (uintptr_t)blk2userptr(blk);
 
-    blk->size = blk_size;
-    heap_free_blk(blk);
+    blk_set_size(blk, blk->size - HEAP_BLK_HEAD_SIZE);
+    if ((uptr & (align - 1)) != 0) {
+        util_size_t gap  = (util_size_t)(((uptr + HEAP_BLK_MIN_SIZE + align - 1) & ~(uintptr_t)(align - 1)) - uptr);
+        memblk_t*   blk2 = (memblk_t*)((uint8_t*)blk + gap);
+
+        // the front is a free block
+        util_queue_node_t* next = blk->all_link.next;
+
+        blk_set_size(blk2, blk_get_size(blk) - gap);
+        util_queue_insert(next, &blk2->all_link);   // insert blk2 after blk
+        blk->size = gap;
+        heap_free_blk(blk);
+        blk = blk2;
+    }
+
+    heap_trim_blk(blk, blk_size);
+    heap_stat_alloc(nbytes);
+    return blk2userptr(blk);
 }
 
 
@@ -144,19 +207,33 @@ void* util_realloc(void* optr, util_size_t nsize)
         heap_init();
     }
 
-    void* nptr = nullptr;
-
-    if (nsize) {
-        nptr = util_malloc(nsize);
+    if (optr == nullptr) {
+        return util_malloc(nsize);
+    }
+    if (nsize == 0) {
+        util_free(optr);
+        return nullptr;
     }
 
-    if (nptr && optr) {
-        memblk_t* nblk = userptr2blk(nptr);
-        memblk_t* oblk = userptr2blk(optr);
-        memcpy(nptr, optr, util_min2(blk_get_size(oblk), blk_get_size(nblk)));
+    memblk_t* oblk = userptr2blk(optr);
+
+    // check block magic
+    cond_check((!blk_chk_magic(oblk) || nsize > HEAP_SIZE), return nullptr);
+
+    // shrink, or grow into the free block after it
+    util_size_t blk_size = blk_size_of(nsize);
+
+    if (blk_size <= blk_get_size(oblk) + HEAP_BLK_HEAD_SIZE || heap_grow_blk(oblk, blk_size)) {
+        heap_trim_blk(oblk, blk_size);
+        heap_stat_peak();
+        return optr;
     }
 
-    if (optr) {
+    void* nptr = util_malloc(nsize);
+
+    // keep the old block if fail
+    if (nptr != nullptr) {
+        memcpy(nptr, optr, util_min2(blk_get_size(oblk), nsize));
         util_free(optr);
     }
 
@@ -164,12 +241,51 @@ void* util_realloc(void* optr, util_size_t nsize)
 }
 
 
+util_size_t util_usable_size(void* ptr)
+{
+    memblk_t* blk = (ptr == nullptr) ? nullptr : heap_userptr2blk(ptr);
+
+    return (blk == nullptr) ? 0 : blk_get_size(blk);
+}
+
+
 util_size_t util_heap_freesize(void)
 {
     return heap_free_size;
 }
 
 
+void util_heap_stat(util_heap_stat_t* stat)
+{
+    util_queue_node_t* free_list = &heap_free_blocks[HEAP_LARGE_BLK_IDX];
+
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    *stat              = heap_stat;
+    stat->heap_size    = HEAP_SIZE;
+    stat->used_size    = HEAP_SIZE - heap_free_size;
+    stat->free_size    = heap_free_size;
+    stat->free_largest = 0;
+
+    // the large list is sorted by size, the last one is the largest. or the largest of the highest small slot
+    if (!util_queue_empty(free_list)) {
+        stat->free_largest = util_containerof(memblk_t, free_link, free_list->prev)->size;
+    } else {
+        for (util_size_t slot = HEAP_LARGE_BLK_IDX; slot-- > 0 && stat->free_largest == 0;) {
+            util_queue_foreach(node, &heap_free_blocks[slot])
+            {
+                stat->free_largest = util_max2(stat->free_largest, util_containerof(memblk_t, free_link, node)->size);
+            }
+        }
+    }
+
+    stat->frag_permille =
+        (heap_free_size == 0) ? 0 : (uint32_t)(1000 - (uint64_t)stat->free_largest * 1000 / heap_free_size);
+}
+
+
 static void heap_init(void)
 {
     memblk_t* blk = (memblk_t*)heap_space;
@@ -206,7 +322,7 @@ static memblk_t* heap_alloc_blk(util_size_t nbytes)
     if (nbytes < HEAP_SMALL_BLK_MAX) {
         if (!util_queue_empty(free_list)) {
             blk = util_containerof(memblk_t, free_link, free_list->next);
-            util_queue_remove(&blk->free_link);
+            heap_rm_free_blk(blk);
             heap_free_size -= blk->size;
             return blk;
         }
@@ -246,7 +362,7 @@ static void heap_free_blk(memblk_t* blk)
     // if prev block is free, merge it
     if (prev_blk && !blk_chk_magic(prev_blk) && (uint8_t*)prev_blk + prev_blk->size == (uint8_t*)blk) {
         util_queue_remove(&prev_blk->all_link);
-        util_queue_remove(&prev_blk->free_link);
+        heap_rm_free_blk(prev_blk);
 
         heap_log("- merge block %p & %p\n", prev_blk, blk);
 
@@ -259,7 +375,7 @@ static void heap_free_blk(memblk_t* blk)
         next = next->next;
 
         util_queue_remove(&next_blk->all_link);
-        util_queue_remove(&next_blk->free_link);
+        heap_rm_free_blk(next_blk);
 
         heap_log("- merge block %p & %p\n", blk, next_blk);
 
@@ -293,7 +409,7 @@ static memblk_t* heap_get_blk_from_slot(util_size_t nbytes, util_size_t slot)
     }
 
     // get a free block
-    util_queue_remove(&blk->free_link);
+    heap_rm_free_blk(blk);
 
     // the block is larger, divide this block. ensure the remaining block size
     if (blk->size >= nbytes + HEAP_BLK_MIN_SIZE) {
@@ -315,11 +431,94 @@ static memblk_t* heap_get_blk_from_slot(util_size_t nbytes, util_size_t slot)
 }
 
 
+/**
+ * @brief the block is larger, divide this block and free the tail. ensure the remaining block size
+ *
+ * @param blk used block
+ * @param nbytes
+ */
+static void heap_trim_blk(memblk_t* blk, util_size_t nbytes)
+{
+    util_size_t size = blk_get_size(blk) + HEAP_BLK_HEAD_SIZE;
+
+    if (size < nbytes + HEAP_BLK_MIN_SIZE) {
+        return;
+    }
+
+    // blk2 is a new free block, blk is marked used, not merged back
+    memblk_t*          blk2 = (memblk_t*)((uint8_t*)blk + nbytes);
+    util_queue_node_t* next = blk->all_link.next;
+
+    blk_set_size(blk, nbytes - HEAP_BLK_HEAD_SIZE);
+    blk2->size = size - nbytes;
+    util_queue_insert(next, &blk2->all_link);   // insert blk2 after blk
+    heap_free_blk(blk2);
+}
+
+
+/**
+ * @brief take the free block after it, if they are large enough together
+ *
+ * @param blk used block
+ * @param nbytes
+ * @return true blk is grown, maybe larger than nbytes
+ * @return false
+ */
+static bool heap_grow_blk(memblk_t* blk, util_size_t nbytes)
+{
+    util_size_t size = blk_get_size(blk) + HEAP_BLK_HEAD_SIZE;
+    memblk_t*   next_blk =
+        (blk->all_link.next == &heap_all_blocks) ? nullptr : util_containerof(memblk_t, all_link, blk->all_link.next);
+
+    if (next_blk == nullptr || blk_chk_magic(next_blk) || (uint8_t*)blk + size != (uint8_t*)next_blk ||
+        size + next_blk->size < nbytes) {
+        return false;
+    }
+
+    util_queue_remove(&next_blk->all_link);
+    heap_rm_free_blk(next_blk);
+    heap_free_size -= next_blk->size;
+    blk_set_size(blk, size + next_blk->size - HEAP_BLK_HEAD_SIZE);
+
+    return true;
+}
+
+
+/**
+ * @brief check the pointer given by user
+ *
+ * @param ptr
+ * @return memblk_t* nullptr if it's not a used block
+ */
+static memblk_t* heap_userptr2blk(void* ptr)
+{
+    cond_check((!heap_inited), return nullptr);
+
+    // check addr align
+    cond_check((((uintptr_t)ptr & (HEAP_ADDR_ALIGN - 1)) != 0), return nullptr);
+
+    // check addr in heap field
+    cond_check(((uint8_t*)ptr < (uint8_t*)HEAP_ADDR_START || (uint8_t*)ptr > (uint8_t*)HEAP_ADDR_END), return nullptr);
+
+    memblk_t* blk = userptr2blk(ptr);
+
+    // check block magic
+    cond_check((!blk_chk_magic(blk)), return nullptr);
+
+    // check block size
+    cond_check(((uint8_t*)blk + blk_get_size(blk) + HEAP_BLK_HEAD_SIZE > (uint8_t*)HEAP_ADDR_END), return nullptr);
+
+    return blk;
+}
+
+
 static void heap_add_free_blk_by_size(memblk_t* blk)
 {
     util_size_t        slot      = blk_slot_idx(blk->size);
     util_queue_node_t* free_list = &heap_free_blocks[slot];
 
+    heap_stat.free_blk_num++;
+
     if (blk->size <= HEAP_SMALL_BLK_MAX) {
         // add free blk to table
         util_queue_insert(free_list, &blk->free_link);
@@ -335,6 +534,36 @@ static void heap_add_free_blk_by_size(memblk_t* blk)
 }
 
 
+static void heap_rm_free_blk(memblk_t* blk)
+{
+    util_queue_remove(&blk->free_link);
+    heap_stat.free_blk_num--;
+}
+
+
+/**
+ * @brief count a malloc done
+ *
+ * @param nbytes size asked
+ */
+static void heap_stat_alloc(util_size_t nbytes)
+{
+    uint32_t idx = (nbytes <= 16) ? 0 : 28 - util_clz(nbytes - 1);   // 17..32: 1, 33..64: 2
+
+    heap_stat.alloc_cnt++;
+    heap_stat.size_hist[util_min2(idx, UTIL_HEAP_HIST_NUM - 1)]++;
+    heap_stat_peak();
+}
+
+
+static void heap_stat_peak(void)
+{
+    if (HEAP_SIZE - heap_free_size > heap_stat.used_peak) {
+        heap_stat.used_peak = HEAP_SIZE - heap_free_size;
+    }
+}
+
+
 void util_heapinfo(void)
 {
     if (!heap_inited) {
@@ -351,13 +580,13 @@ void util_heapinfo(void)
     heap_log("all blocks:");
     node = heap_all_blocks.next;
 
-    util_size_t next_start = (util_size_t)heap_space;
+    util_size_t next_start = (util_size_t)(uintptr_t)heap_space;
 
     while (node != &heap_all_blocks) {
         blk = util_containerof(memblk_t, all_link, node);
 
         bool        busy  = blk_chk_magic(blk);
-        util_size_t start = (util_size_t)blk;
+        util_size_t start = (util_size_t)(uintptr_t)blk;
         util_size_t size  = busy ? blk_get_size(blk) + HEAP_BLK_HEAD_SIZE : blk_get_size(blk);
 
         heap_log("    %s  [0x%08x, 0x%08x)  %5d bytes", busy ? "[+]" : "[ ]", start, start + size, size);
@@ -381,7 +610,7 @@ void util_heapinfo(void)
             blk = util_containerof(memblk_t, free_link, node);
 
             bool        busy  = blk_chk_magic(blk);
-            util_size_t start = (util_size_t)blk;
+            util_size_t start = (util_size_t)(uintptr_t)blk;
             util_size_t size  = blk_get_size(blk);
 
             start = start;
@@ -395,3 +624,6 @@ void util_heapinfo(void)
     }
     heap_log("+----------------------------------------+\n");
 }
+
+#endif
+
@@ -14,12 +14,41 @@
 
 #include "util_types.h"
 
+#ifndef UTIL_HEAP_BUFFER_SIZE
 #define UTIL_HEAP_BUFFER_SIZE (20 * 1024)
+#endif
+
+// backend of heap, select by -DUTIL_HEAP_BACKEND=...
+#define UTIL_HEAP_BACKEND_SLOT 0   // exact size lists of small blocks and a size-sorted list of large blocks
+#define UTIL_HEAP_BACKEND_TLSF 1   // two-level segregated fit, O(1) malloc and free of any size
+#ifndef UTIL_HEAP_BACKEND
+#define UTIL_HEAP_BACKEND UTIL_HEAP_BACKEND_TLSF
+#endif
+
+#define UTIL_HEAP_HIST_NUM 8   // classes of sizes asked: <= 16, <= 32, ..., <= 1024, > 1024
+
+typedef struct {
+    util_size_t heap_size;                       // bytes of the buffer
+    util_size_t used_size;                       // bytes of used blocks, with heads
+    util_size_t used_peak;                       // max used_size ever, the heap needs no more than it
+    util_size_t free_size;                       //
+    util_size_t free_largest;                    // the largest free block, mallocs larger than it fail
+    uint32_t    free_blk_num;                    // free blocks
+    uint32_t    frag_permille;                   // external fragmentation, 1 - free_largest / free_size
+    uint32_t    alloc_cnt;                       // mallocs done, not counting realloc in place
+    uint32_t    free_cnt;                        // frees done, not counting realloc in place
+    uint32_t    fail_cnt;                        // mallocs failed
+    uint32_t    size_hist[UTIL_HEAP_HIST_NUM];   // mallocs done by size asked
+} util_heap_stat_t;
 
 void*       util_malloc(util_size_t nbytes);
+void*       util_calloc(util_size_t num, util_size_t size);
+void*       util_malloc_aligned(util_size_t nbytes, util_size_t align);   // align: power of 2, free by util_free
 void        util_free(void* ptr);
-void*       util_realloc(void* optr, util_size_t nsize);
+void*       util_realloc(void* optr, util_size_t nsize);   // in place if it shrinks or the next block is free
+util_size_t util_usable_size(void* ptr);                    // bytes usable of a block, >= the size asked, 0 if invalid
 util_size_t util_heap_freesize(void);
+void        util_heap_stat(util_heap_stat_t* stat);   // counters are kept all the time, the heap is not locked
 void        util_heapinfo(void);
 
 #endif
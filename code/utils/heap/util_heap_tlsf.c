@@ -0,0 +1,615 @@
+/**
+ * @file util_heap_tlsf.c
+ * @brief memory management, two-level segregated fit
+ * @note free blocks are in lists indexed by the log2 of size (first level) and by the next HEAP_SL_LOG2 bits of size
+ *       (second level), a bitmap of each level tells the non-empty lists. malloc rounds the size up to the next list,
+ *       so the head of any non-empty list found by the bitmaps fits. free merges neighbours by the physical links.
+ *       both are O(1), no list is walked
+ */
+#include "util_heap.h"
+#include "util_misc.h"
+
+#if UTIL_HEAP_BACKEND == UTIL_HEAP_BACKEND_TLSF
+
+// clang-format off
+#define heap_log(...)                   // util_printf(__VA_ARGS__),util_printf('\n')
+#define heap_err(...)                   // util_printf("ERR: "), util_printf(__VA_ARGS__), util_printf(" in %s", __func__), util_printf("\n")
+#define cond_check(err_cond, action)    do { if ((err_cond)) { heap_err(#err_cond); action; } } while (0)
+// clang-format on
+
+/*
+ block head:
+    prev_phys  : the block before in address, nullptr for the first block
+    size       : block size include head; for used block: (MAGIC | block_size)
+ links of free list are in the user space of free block
+ */
+#define HEAP_BLK_HEAD                                                                                                  \
+    struct memblk_t* prev_phys;                                                                                        \
+    util_size_t      size
+
+typedef struct {
+    HEAP_BLK_HEAD;
+} blkhead_t;
+
+typedef struct memblk_t {
+    HEAP_BLK_HEAD;
+    struct memblk_t* next_free;   // link block in heap_free_lists, free block only
+    struct memblk_t* prev_free;
+} memblk_t;
+
+// clang-format off
+#define HEAP_SIZE                  UTIL_HEAP_BUFFER_SIZE  // heap size
+#define HEAP_ADDR_ALIGN            8                      //
+#define HEAP_BLK_SIZE_UNIT         8u                     // block size will round up to a multiple of HEAP_BLK_SIZE_UNIT
+#define HEAP_SL_LOG2               4u                     // 16 second level lists of each first level
+#define HEAP_SL_NUM                (1u << HEAP_SL_LOG2)
+#define HEAP_FL_SHIFT              (HEAP_SL_LOG2 + 3)     // blocks smaller than 1 << HEAP_FL_SHIFT are in first level 0
+#define HEAP_FL_NUM                (HEAP_FL_LOG2_MAX - HEAP_FL_SHIFT + 2)
+
+#define HEAP_ADDR_START            ((uint8_t*)heap_space)
+#define HEAP_ADDR_END              ((uint8_t*)heap_space + sizeof(heap_space))
+#define HEAP_BLK_MAGIC_MASK        0xA5000000             // used to identify the allocated blocks
+#define HEAP_BLK_SIZE_MASK         0x00FFFFFF
+#define HEAP_BLK_HEAD_SIZE         sizeof(blkhead_t)
+#define HEAP_BLK_MIN_SIZE          blk_size_roundup(sizeof(memblk_t))
+
+#define blk_get_size(blk)          ((blk)->size & HEAP_BLK_SIZE_MASK)
+#define blk_set_used(blk)          ((blk)->size |= HEAP_BLK_MAGIC_MASK)
+#define blk_chk_magic(blk)         (((blk)->size & HEAP_BLK_MAGIC_MASK) == HEAP_BLK_MAGIC_MASK)
+#define blk_size_roundup(nbytes)   (((nbytes) + HEAP_BLK_SIZE_UNIT - 1) & ~(HEAP_BLK_SIZE_UNIT - 1))
+#define blk_size_of(nbytes)        blk_size_roundup(util_max2((nbytes) + HEAP_BLK_HEAD_SIZE, HEAP_BLK_MIN_SIZE))
+#define blk_next_phys(blk)         ((memblk_t*)((uint8_t*)(blk) + blk_get_size(blk)))
+
+#define blk2userptr(blk)           ((uint8_t*)(blk) + HEAP_BLK_HEAD_SIZE)
+#define userptr2blk(uptr)          ((memblk_t*)((uint8_t*)(uptr) - HEAP_BLK_HEAD_SIZE))
+// clang-format on
+
+// log2 of the largest block, no more first levels than the heap needs
+#if HEAP_SIZE > HEAP_BLK_SIZE_MASK
+#error "UTIL_HEAP_BUFFER_SIZE is too large"
+#elif HEAP_SIZE < (1u << 15)
+#define HEAP_FL_LOG2_MAX 14
+#elif HEAP_SIZE < (1u << 18)
+#define HEAP_FL_LOG2_MAX 17
+#elif HEAP_SIZE < (1u << 21)
+#define HEAP_FL_LOG2_MAX 20
+#else
+#define HEAP_FL_LOG2_MAX 23
+#endif
+
+
+static uint64_t         heap_space[HEAP_SIZE / 8];                   // 8 bytes aligned
+static memblk_t*        heap_free_lists[HEAP_FL_NUM][HEAP_SL_NUM];   // heads of free lists
+static uint32_t         heap_fl_bitmap;                              // bit fl: heap_sl_bitmap[fl] != 0
+static uint32_t         heap_sl_bitmap[HEAP_FL_NUM];                 // bit sl: heap_free_lists[fl][sl] != nullptr
+static util_size_t      heap_free_size = 0;
+static bool             heap_inited    = false;
+static util_heap_stat_t heap_stat;   // counters, the others are got by util_heap_stat
+
+
+static void      heap_init(void);
+static void      heap_mapping(util_size_t nbytes, uint32_t* fl, uint32_t* sl);
+static memblk_t* heap_find_free_blk(util_size_t nbytes);
+static void      heap_insert_free_blk(memblk_t* blk);
+static void      heap_remove_free_blk(memblk_t* blk);
+static void      heap_unlink_free_blk(memblk_t* blk, uint32_t fl, uint32_t sl);
+static memblk_t* heap_alloc_blk(util_size_t nbytes);
+static void      heap_free_blk(memblk_t* blk);
+static void      heap_trim_blk(memblk_t* blk, util_size_t nbytes);
+static bool      heap_grow_blk(memblk_t* blk, util_size_t nbytes);
+static memblk_t* heap_userptr2blk(void* ptr);
+static void      heap_stat_alloc(util_size_t nbytes);
+static void      heap_stat_peak(void);
+
+
+void* util_malloc(util_size_t nbytes)
+{
+    if (nbytes == 0 || nbytes > HEAP_SIZE) {
+        return nullptr;
+    }
+
+    util_size_t blk_size = blk_size_of(nbytes);
+
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    memblk_t* blk = (blk_size > heap_free_size) ? nullptr : heap_alloc_blk(blk_size);
+
+    if (blk != nullptr) {
+        heap_trim_blk(blk, blk_size);
+        heap_log("- malloc %d bytes @0x%08x\n", blk_get_size(blk), (util_size_t)blk);
+        heap_stat_alloc(nbytes);
+        return blk2userptr(blk);
+    } else {
+        heap_err("! malloc fail\n");
+        heap_stat.fail_cnt++;
+        return nullptr;
+    }
+}
+
+
+void* util_malloc_aligned(util_size_t nbytes, util_size_t align)
+{
+    // not power of 2
+    cond_check((align == 0 || (align & (align - 1)) != 0), return nullptr);
+
+    if (align <= HEAP_ADDR_ALIGN) {
+        return util_malloc(nbytes);
+    }
+    if (nbytes == 0 || nbytes > HEAP_SIZE || align > HEAP_SIZE) {
+        return nullptr;
+    }
+
+    util_size_t blk_size = blk_size_of(nbytes);
+
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    // room to put a free block before the aligned one
+    memblk_t* blk = heap_alloc_blk(blk_size + align + HEAP_BLK_MIN_SIZE);
+    if (blk == nullptr) {
+        heap_err("! malloc fail\n");
+        heap_stat.fail_cnt++;
+        return nullptr;
+    }
+
+    uintptr_t uptr = (uintptr_t)blk2userptr(blk);
+
+    if ((uptr & (align - 1)) != 0) {
+        util_size_t gap  = (util_size_t)(((uptr + HEAP_BLK_MIN_SIZE + align - 1) & ~(uintptr_t)(align - 1)) - uptr);
+        memblk_t*   blk2 = (memblk_t*)((uint8_t*)blk + gap);
+
+        // the front is a free block
+        blk2->prev_phys                = blk;
+        blk2->size                     = (blk_get_size(blk) - gap) | HEAP_BLK_MAGIC_MASK;
+        blk_next_phys(blk2)->prev_phys = blk2;
+        blk->size                      = gap;
+        heap_free_blk(blk);
+        blk = blk2;
+    }
+
+    heap_trim_blk(blk, blk_size);
+    heap_stat_alloc(nbytes);
+    return blk2userptr(blk);
+}
+
+
+void util_free(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    memblk_t* blk = heap_userptr2blk(ptr);
+
+    if (blk != nullptr) {
+        blk->size = blk_get_size(blk);
+        heap_free_blk(blk);
+        heap_stat.free_cnt++;
+    }
+}
+
+
+void* util_realloc(void* optr, util_size_t nsize)
+{
+    if (optr == nullptr) {
+        return util_malloc(nsize);
+    }
+    if (nsize == 0) {
+        util_free(optr);
+        return nullptr;
+    }
+
+    memblk_t* oblk = heap_userptr2blk(optr);
+
+    if (oblk == nullptr || nsize > HEAP_SIZE) {
+        return nullptr;
+    }
+
+    // shrink, or grow into the free block after it
+    util_size_t blk_size = blk_size_of(nsize);
+
+    if (blk_size <= blk_get_size(oblk) || heap_grow_blk(oblk, blk_size)) {
+        heap_trim_blk(oblk, blk_size);
+        heap_stat_peak();
+        return optr;
+    }
+
+    void* nptr = util_malloc(nsize);
+
+    // keep the old block if fail
+    if (nptr != nullptr) {
+        memcpy(nptr, optr, util_min2(blk_get_size(oblk) - HEAP_BLK_HEAD_SIZE, nsize));
+        util_free(optr);
+    }
+
+    return nptr;
+}
+
+
+util_size_t util_usable_size(void* ptr)
+{
+    memblk_t* blk = (ptr == nullptr) ? nullptr : heap_userptr2blk(ptr);
+
+    return (blk == nullptr) ? 0 : blk_get_size(blk) - HEAP_BLK_HEAD_SIZE;
+}
+
+
+util_size_t util_heap_freesize(void)
+{
+    return heap_free_size;
+}
+
+
+void util_heap_stat(util_heap_stat_t* stat)
+{
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    *stat              = heap_stat;
+    stat->heap_size    = HEAP_SIZE;
+    stat->used_size    = HEAP_SIZE - heap_free_size;
+    stat->free_size    = heap_free_size;
+    stat->free_largest = 0;
+
+    // the largest is in the highest non-empty list, which holds a range of sizes
+    if (heap_fl_bitmap != 0) {
+        uint32_t fl = 31 - util_clz(heap_fl_bitmap);
+        uint32_t sl = 31 - util_clz(heap_sl_bitmap[fl]);
+
+        for (memblk_t* blk = heap_free_lists[fl][sl]; blk != nullptr; blk = blk->next_free) {
+            stat->free_largest = util_max2(stat->free_largest, blk->size);
+        }
+    }
+
+    stat->frag_permille =
+        (heap_free_size == 0) ? 0 : (uint32_t)(1000 - (uint64_t)stat->free_largest * 1000 / heap_free_size);
+}
+
+
+/**
+ * @brief get a free block not smaller than nbytes, it's marked used
+ *
+ * @param nbytes
+ * @return memblk_t*
+ */
+static memblk_t* heap_alloc_blk(util_size_t nbytes)
+{
+    memblk_t* blk = heap_find_free_blk(nbytes);
+
+    if (blk != nullptr) {
+        heap_free_size -= blk->size;
+        blk_set_used(blk);
+    }
+
+    return blk;
+}
+
+
+/**
+ * @brief put a block back to free lists, merge the free neighbours
+ *
+ * @param blk size is unmarked
+ */
+static void heap_free_blk(memblk_t* blk)
+{
+    memblk_t* prev_blk = blk->prev_phys;
+    memblk_t* next_blk = blk_next_phys(blk);
+
+    heap_free_size += blk->size;
+
+    // if prev block is free, merge it
+    if (prev_blk && !blk_chk_magic(prev_blk)) {
+        heap_remove_free_blk(prev_blk);
+        heap_log("- merge block %p & %p\n", prev_blk, blk);
+        prev_blk->size += blk->size;
+        blk = prev_blk;
+    }
+
+    // if next block is free, merge it, the sentinel at the end is never free
+    if (!blk_chk_magic(next_blk)) {
+        heap_remove_free_blk(next_blk);
+        heap_log("- merge block %p & %p\n", blk, next_blk);
+        blk->size += next_blk->size;
+    }
+
+    blk_next_phys(blk)->prev_phys = blk;
+    heap_insert_free_blk(blk);
+}
+
+
+/**
+ * @brief the block is larger, divide this block and free the tail. ensure the remaining block size
+ *
+ * @param blk used block
+ * @param nbytes
+ */
+static void heap_trim_blk(memblk_t* blk, util_size_t nbytes)
+{
+    util_size_t size = blk_get_size(blk);
+
+    if (size < nbytes + HEAP_BLK_MIN_SIZE) {
+        return;
+    }
+
+    // blk2 is a new free block, blk is marked used, not merged back
+    memblk_t* blk2 = (memblk_t*)((uint8_t*)blk + nbytes);
+
+    blk->size       = nbytes | HEAP_BLK_MAGIC_MASK;
+    blk2->prev_phys = blk;
+    blk2->size      = size - nbytes;
+
+    blk_next_phys(blk2)->prev_phys = blk2;
+    heap_free_blk(blk2);
+}
+
+
+/**
+ * @brief take the free block after it, if they are large enough together
+ *
+ * @param blk used block
+ * @param nbytes
+ * @return true blk is grown, maybe larger than nbytes
+ * @return false
+ */
+static bool heap_grow_blk(memblk_t* blk, util_size_t nbytes)
+{
+    memblk_t*   next_blk = blk_next_phys(blk);
+    util_size_t size     = blk_get_size(blk);
+
+    if (blk_chk_magic(next_blk) || size + next_blk->size < nbytes) {
+        return false;
+    }
+
+    heap_remove_free_blk(next_blk);
+    heap_free_size -= next_blk->size;
+    blk->size = (size + next_blk->size) | HEAP_BLK_MAGIC_MASK;
+    blk_next_phys(blk)->prev_phys = blk;
+
+    return true;
+}
+
+
+/**
+ * @brief check the pointer given by user
+ *
+ * @param ptr
+ * @return memblk_t* nullptr if it's not a used block
+ */
+static memblk_t* heap_userptr2blk(void* ptr)
+{
+    cond_check((!heap_inited), return nullptr);
+
+    // check addr align
+    cond_check((((uintptr_t)ptr & (HEAP_ADDR_ALIGN - 1)) != 0), return nullptr);
+
+    // check addr in heap field
+    cond_check(((uint8_t*)ptr < HEAP_ADDR_START + HEAP_BLK_HEAD_SIZE || (uint8_t*)ptr >= HEAP_ADDR_END), return nullptr);
+
+    memblk_t* blk = userptr2blk(ptr);
+
+    // check block magic
+    cond_check((!blk_chk_magic(blk)), return nullptr);
+
+    // check block size
+    cond_check(((uint8_t*)blk_next_phys(blk) + HEAP_BLK_HEAD_SIZE > HEAP_ADDR_END), return nullptr);
+
+    return blk;
+}
+
+
+/**
+ * @brief one free block of the whole heap, and a used block of size 0 at the end as sentinel
+ *
+ */
+static void heap_init(void)
+{
+    memblk_t*  blk      = (memblk_t*)heap_space;
+    blkhead_t* sentinel = (blkhead_t*)(HEAP_ADDR_END - HEAP_BLK_HEAD_SIZE);
+
+    memset(heap_free_lists, 0, sizeof(heap_free_lists));
+    memset(heap_sl_bitmap, 0, sizeof(heap_sl_bitmap));
+    heap_fl_bitmap = 0;
+
+    blk->prev_phys      = nullptr;
+    blk->size           = (util_size_t)((uint8_t*)sentinel - HEAP_ADDR_START);
+    sentinel->prev_phys = blk;
+    sentinel->size      = HEAP_BLK_MAGIC_MASK;
+    heap_insert_free_blk(blk);
+
+    heap_free_size = blk->size;
+    heap_inited    = true;
+}
+
+
+/**
+ * @brief indexes of the list of blocks of this size
+ *
+ * @param nbytes
+ * @param fl first level, log2 of size
+ * @param sl second level, the next HEAP_SL_LOG2 bits of size
+ */
+static void heap_mapping(util_size_t nbytes, uint32_t* fl, uint32_t* sl)
+{
+    if (nbytes < (1u << HEAP_FL_SHIFT)) {
+        *fl = 0;
+        *sl = nbytes / HEAP_BLK_SIZE_UNIT;
+    } else {
+        uint32_t log2 = 31 - util_clz(nbytes);
+
+        *fl = log2 - HEAP_FL_SHIFT + 1;
+        *sl = (nbytes >> (log2 - HEAP_SL_LOG2)) ^ HEAP_SL_NUM;
+    }
+}
+
+
+/**
+ * @brief get a free block not smaller than nbytes, and remove it from its list
+ *
+ * @param nbytes
+ * @return memblk_t*
+ */
+static memblk_t* heap_find_free_blk(util_size_t nbytes)
+{
+    uint32_t    fl, sl, sl_bitmap, fl_bitmap;
+    util_size_t rounded = nbytes;
+    memblk_t*   blk     = nullptr;
+
+    // round up to the next list, any block of it and above fits
+    if (nbytes >= (1u << HEAP_FL_SHIFT)) {
+        rounded += (1u << (31 - util_clz(nbytes) - HEAP_SL_LOG2)) - 1;
+    }
+    heap_mapping(rounded, &fl, &sl);
+
+    // larger lists of the same first level, or the smallest list of a larger first level
+    sl_bitmap = (fl < HEAP_FL_NUM) ? heap_sl_bitmap[fl] & (~0u << sl) : 0;
+    if (sl_bitmap == 0) {
+        fl_bitmap = (fl + 1 < HEAP_FL_NUM) ? heap_fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_bitmap != 0) {
+            fl        = util_ctz(fl_bitmap);
+            sl_bitmap = heap_sl_bitmap[fl];
+        }
+    }
+
+    if (sl_bitmap != 0) {
+        sl = util_ctz(sl_bitmap);
+    } else {
+        // nothing above, the head of the list of nbytes may still fit, e.g. the whole heap
+        heap_mapping(nbytes, &fl, &sl);
+        if (fl >= HEAP_FL_NUM || heap_free_lists[fl][sl] == nullptr || heap_free_lists[fl][sl]->size < nbytes) {
+            return nullptr;
+        }
+    }
+
+    blk = heap_free_lists[fl][sl];
+    heap_unlink_free_blk(blk, fl, sl);
+    return blk;
+}
+
+
+static void heap_insert_free_blk(memblk_t* blk)
+{
+    uint32_t fl, sl;
+
+    heap_mapping(blk->size, &fl, &sl);
+
+    blk->prev_free = nullptr;
+    blk->next_free = heap_free_lists[fl][sl];
+    if (blk->next_free != nullptr) {
+        blk->next_free->prev_free = blk;
+    }
+    heap_free_lists[fl][sl] = blk;
+
+    heap_sl_bitmap[fl] |= 1u << sl;
+    heap_fl_bitmap |= 1u << fl;
+    heap_stat.free_blk_num++;
+}
+
+
+static void heap_remove_free_blk(memblk_t* blk)
+{
+    uint32_t fl, sl;
+
+    heap_mapping(blk->size, &fl, &sl);
+    heap_unlink_free_blk(blk, fl, sl);
+}
+
+
+static void heap_unlink_free_blk(memblk_t* blk, uint32_t fl, uint32_t sl)
+{
+    heap_stat.free_blk_num--;
+    if (blk->next_free != nullptr) {
+        blk->next_free->prev_free = blk->prev_free;
+    }
+    if (blk->prev_free != nullptr) {
+        blk->prev_free->next_free = blk->next_free;
+    } else {
+        heap_free_lists[fl][sl] = blk->next_free;
+        if (blk->next_free == nullptr) {
+            heap_sl_bitmap[fl] &= ~(1u << sl);
+            if (heap_sl_bitmap[fl] == 0) {
+                heap_fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief count a malloc done
+ *
+ * @param nbytes size asked
+ */
+static void heap_stat_alloc(util_size_t nbytes)
+{
+    uint32_t idx = (nbytes <= 16) ? 0 : 28 - util_clz(nbytes - 1);   // 17..32: 1, 33..64: 2
+
+    heap_stat.alloc_cnt++;
+    heap_stat.size_hist[util_min2(idx, UTIL_HEAP_HIST_NUM - 1)]++;
+    heap_stat_peak();
+}
+
+
+static void heap_stat_peak(void)
+{
+    if (HEAP_SIZE - heap_free_size > heap_stat.used_peak) {
+        heap_stat.used_peak = HEAP_SIZE - heap_free_size;
+    }
+}
+
+
+void util_heapinfo(void)
+{
+    if (!heap_inited) {
+        heap_init();
+    }
+
+    memblk_t* blk  = (memblk_t*)heap_space;
+    memblk_t* prev = nullptr;
+
+    heap_log("+----------------------------------------+");
+    heap_log("heap:");
+    heap_log("         [0x%08x, 0x%08x)  %d bytes free", (util_size_t)HEAP_ADDR_START, (util_size_t)HEAP_ADDR_END,
+             heap_free_size);
+    heap_log("all blocks:");
+
+    while (blk_get_size(blk) != 0) {
+        bool        busy  = blk_chk_magic(blk);
+        util_size_t start = (util_size_t)(uintptr_t)blk;
+        util_size_t size  = blk_get_size(blk);
+
+        (void)start;   // only by heap_log
+        (void)size;
+        heap_log("    %s  [0x%08x, 0x%08x)  %5d bytes", busy ? "[+]" : "[ ]", start, start + size, size);
+
+        if (blk->prev_phys != prev || (prev && !busy && !blk_chk_magic(prev))) {
+            heap_err("!!! physical link broken");
+            extern void exit(int);
+            exit(0);
+        }
+
+        prev = blk;
+        blk  = blk_next_phys(blk);
+    }
+
+    heap_log("free blocks:\n");
+    for (uint32_t fl = 0; fl < HEAP_FL_NUM; fl++) {
+        for (uint32_t sl = 0; sl < HEAP_SL_NUM; sl++) {
+            for (blk = heap_free_lists[fl][sl]; blk != nullptr; blk = blk->next_free) {
+                util_size_t start = (util_size_t)(uintptr_t)blk;
+                util_size_t size  = blk_get_size(blk);
+
+                (void)start;   // only by heap_log
+                (void)size;
+                heap_log("    [ ]  [0x%08x, 0x%08x)  %5d bytes %s\n", start, start + size, size,
+                         blk_chk_magic(blk) ? "ERROR" : "");
+            }
+        }
+    }
+    heap_log("+----------------------------------------+\n");
+}
+
+#endif
@@ -40,8 +40,8 @@
 #define util_bitmap_clr(u32bitmaparray, pos) u32bitmaparray[pos >> 5] &= ~((uint32_t)0x1 << (pos & 0x1F))
 #define util_bitmap_chk(u32bitmaparray, pos) (u32bitmaparray[pos >> 5] & ((uint32_t)0x1 << (pos & 0x1F)))
 
-#define util_containerof(type, field, ptr)   ((type*)((uint8_t*)(ptr) - (uint32_t) & ((type*)0)->field))
-#define util_fieldoffset(type, field)        ((uint32_t) & (((type*)0)->field))
+#define util_containerof(type, field, ptr)   ((type*)((uint8_t*)(ptr) - (uintptr_t) & ((type*)0)->field))
+#define util_fieldoffset(type, field)        ((uint32_t)(uintptr_t) & (((type*)0)->field))
 
 #define util_getbigendian2(buf)              (((uint16_t)buf[0] << 8) | ((uint16_t)buf[1] << 0))
 #define util_getbigendian4(buf)              (((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3])
@@ -89,6 +89,42 @@ static inline uint32_t util_bytes2uint_be(uint8_t* buf, uint8_t size)
     return value.u32;
 }
 
+/**
+ * @brief count leading zeros, x should not be 0
+ *
+ * @param x
+ * @return uint32_t
+ */
+static inline uint32_t util_clz(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_clz(x);
+#elif defined(__CC_ARM)
+    return __clz(x);
+#else
+    uint32_t n = 0;
+
+    for (uint32_t shift = 16; shift > 0; shift >>= 1) {
+        if ((x >> (32 - shift)) == 0) {
+            n += shift;
+            x <<= shift;
+        }
+    }
+    return n;
+#endif
+}
+
+/**
+ * @brief count trailing zeros, x should not be 0
+ *
+ * @param x
+ * @return uint32_t
+ */
+static inline uint32_t util_ctz(uint32_t x)
+{
+    return 31 - util_clz(x & (~x + 1));
+}
+
 #ifdef HOST_DEBUG
 #include <stdio.h>
 #define util_printf printf
@@ -2,6 +2,7 @@
 #define _UTILS_H_
 
 #include "cli/util_cli.h"
+#include "heap/util_heap.h"
 #include "log/util_log.h"
 #include "ringbuffer/util_ringbuffer.h"
 #include "util_misc.h"